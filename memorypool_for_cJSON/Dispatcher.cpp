@@ -1,6 +1,6 @@
 #include "Dispatcher.h"
 
-void Dispatcher::frameDecode()//һ֡תΪṹ
+void Dispatcher::frameDecode()//把一个帧转化为结构体
 {
 
 }
@@ -3,7 +3,7 @@
 #include "connectionhandler.h"
 #include "mqtthandler.h"
 
-EventHandler* HandlerFactory::creatHandler(Type type, Reactor* r, Protocol* p)
+EventHandler* HandlerFactory::creatHandler(Type type, IReactor* r, Protocol* p)
 {
     EventHandler* handler = nullptr;
     switch (type)
@@ -7,6 +7,6 @@ class HandlerFactory
 private:
 	Protocol* protocol;
 public:
-	EventHandler* creatHandler(Type type,Reactor *r, Protocol* p);
+	EventHandler* creatHandler(Type type,IReactor *r, Protocol* p);
 };
 
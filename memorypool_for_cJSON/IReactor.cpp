@@ -1,33 +1,435 @@
 #include "IReactor.h"
+#include "accepthandler.h"
+#include "connectionhandler.h"
+#include "sensorsession.h"
+#include "mqtthandler.h"
+#include "wakeuphandler.h"
+#include "udphandler.h"
+#include "ringhandler.h"
 
+#include <mutex>
+#include <string>
+#include <iostream>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
 
 
+std::atomic<IReactor*> IReactor::deviceOwner[DEVICE_MAX];
 
-void IReactor::loop() {
-    while (1) {
-        int nfds = epoll_wait(efd, events, MAX_EVENTS, -1);
-        for (int i = 0; i < nfds; ++i) {
-            int fd = events[i].data.fd;
-            uint32_t revents = events[i].events;
 
-            // 1.  handler Ƿڣֹ֮ǰѭѾɾ
-            if (handler.find(fd) == handler.end()) continue;
+IReactor::IReactor(int s, struct mosquitto* m) : sockfd(s), mosq(m), loopThread(std::this_thread::get_id())
+{
+    // globalMemoryPool 是 thread_local 的，Reactor 在哪个线程构造，内存池前端就属于哪个线程
+    globalMemoryPool = new MemoryPool(65536, 512, 16);
+    initWheel(getWheel());
+    hooks.malloc_fn = myMalloc;
+    hooks.free_fn = myFree;
+    // cJSON 的钩子是进程级全局变量，多个 Reactor 线程只需安装一次
+    static std::once_flag hooksOnce;
+    std::call_once(hooksOnce, [this] { cJSON_InitHooks(&hooks); });
 
-            // 2. 
-            if (revents & (EPOLLIN | EPOLLPRI | EPOLLRDHUP)) {
-                handler[fd]->handleRead(fd);//ؽȡ֡ҵɹ
-            }
+    // 这里只建处理器，监听套接字和 eventfd 由后端在自己的构造函数里挂到多路复用器上
+    if (sockfd != -1) {
+        handler[sockfd] = std::make_shared<AcceptHandler>(this, &protocol);
+    }
+    wakeupfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    handler[wakeupfd] = std::make_shared<WakeupHandler>(this, &protocol);
+
+    for (int i = 0; i < DEVICE_MAX; ++i) deviceFd[i] = -1;
+
+    // libmosquitto 不暴露出口队列长度，用 publish 和写出回调自己计数
+    if (mosq) {
+        mosquitto_user_data_set(mosq, this);
+        mosquitto_publish_callback_set(mosq, mqtt_publish_cb);
+    }
+}
+
+IReactor::~IReactor()
+{
+    // 撤销本 Reactor 在路由表里的登记，之后的命令按设备不在线丢弃
+    for (int i = 0; i < DEVICE_MAX; ++i) {
+        IReactor* self = this;
+        deviceOwner[i].compare_exchange_strong(self, nullptr, std::memory_order_acq_rel);
+    }
+    int fd;
+    while (pendingFds.pop(fd)) close(fd);
+    close(wakeupfd);
+    clearTimeWheel(getWheel());
+    delete globalMemoryPool;
+    globalMemoryPool = nullptr;
+}
+
+void IReactor::newConnection(int cfd)
+{
+    if (subReactors.empty()) {
+        load.fetch_add(1, std::memory_order_relaxed);
+        register_(cfd, EPOLLIN);
+        return;
+    }
+
+    pickReactor(subReactors)->queueConnection(cfd);
+}
+
+void IReactor::newLocalConnection(int cfd)
+{
+    if (localPeers.empty()) {
+        newConnection(cfd);
+        return;
+    }
+    IReactor* target = pickReactor(localPeers);
+    if (target == this) {
+        load.fetch_add(1, std::memory_order_relaxed);
+        register_(cfd, EPOLLIN);
+        return;
+    }
+    target->queueConnection(cfd);
+}
+
+void IReactor::newRingConnection(int cfd)
+{
+    // 映射和处理器都归接手的 Reactor，建环放到它的线程里做
+    const std::vector<IReactor*>& peers = localPeers.empty() ? subReactors : localPeers;
+    IReactor* target = peers.empty() ? this : pickReactor(peers);
+    // 一个环和一条连接一样计入负载，同样在选定时就计入，否则一批生产者会全落到同一个线程上
+    target->load.fetch_add(1, std::memory_order_relaxed);
+    target->runInLoop([target, cfd] { target->openRing(cfd); });
+}
+
+void IReactor::openRing(int cfd)
+{
+    auto ring = std::make_shared<RingHandler>(this, &protocol);
+    if (!ring->open(cfd)) {
+        load.fetch_sub(1, std::memory_order_relaxed);
+        close(cfd);
+        return;
+    }
+    // 生产者拿到 fd 后可能已经写了记录：eventfd 注册时已可读，多路复用器会立即报告
+    ringRegister(cfd, ring);
+    ringRegister(ring->getEventFd(), ring);
+}
+
+IReactor* IReactor::pickReactor(const std::vector<IReactor*>& list)
+{
+    if (balance == Balance::RoundRobin) {
+        IReactor* target = list[next % list.size()];
+        next = (next + 1) % list.size();
+        return target;
+    }
+    // 传感器连接寿命长、流量不均，轮询会让早期的热点一直集中在同一个线程上
+    IReactor* target = list[0];
+    for (IReactor* r : list) {
+        if (r->getLoad() < target->getLoad()) target = r;
+    }
+    return target;
+}
+
+void IReactor::setLocalPeers(const std::vector<IReactor*>& peers, Balance b)
+{
+    localPeers = peers;
+    balance = b;
+    next = 0;
+}
+
+void IReactor::setSubReactors(const std::vector<IReactor*>& subs, Balance b)
+{
+    subReactors = subs;
+    balance = b;
+    next = 0;
+}
+
+void IReactor::queueConnection(int cfd)
+{
+    // 入队时就计入负载，连接风暴期间主 Reactor 才能看到尚未注册的积压
+    load.fetch_add(1, std::memory_order_relaxed);
+    pendingFds.push(cfd);
+    wakeup();
+}
+
+void IReactor::runInLoop(Task task)
+{
+    if (isInLoopThread()) {
+        task();
+    }
+    else {
+        queueInLoop(std::move(task));
+    }
+}
+
+void IReactor::queueInLoop(Task task)
+{
+    pendingTasks.push(std::move(task));
+    wakeup();
+}
+
+void IReactor::wakeup()
+{
+    // 连接风暴或批量投递时只写一次 eventfd，省掉一串系统调用
+    if (!wakeupPending.exchange(true, std::memory_order_acq_rel)) {
+        eventfd_write(wakeupfd, 1);
+    }
+}
+
+void IReactor::doPendingWork()
+{
+    // 先复位再取队列：之后的投递会重新写 eventfd，不会丢唤醒；
+    // exchange 读到的是生产者写入的 true，生产者在此之前入队的数据一定可见
+    wakeupPending.exchange(false, std::memory_order_acq_rel);
+
+    int cfd;
+    while (pendingFds.pop(cfd)) {
+        register_(cfd, EPOLLIN);
+    }
+
+    Task task;
+    while (pendingTasks.pop(task)) {
+        task();
+    }
+}
+
+void IReactor::mqtt_heartbeat_cb(void* args)
+{
+    auto p = static_cast<MqttHandler*>(args);
+    p->handleMisc();
+    TimeWheelNode* node = addNewTimer(p->reactor->getWheel(), mqtt_heartbeat_cb, 60000, p);
+    p->setTimer(node);
+}
+
+void IReactor::egressQueue()
+{
+    ++egressQueued;
+    if (egressQueued > stats.egressPeak) stats.egressPeak = egressQueued;
+    if (!ingressPaused && egressQueued >= EGRESS_HIGH_WATER) {
+        setIngress(true);
+    }
+}
+
+void IReactor::egressDone()
+{
+    if (egressQueued > 0) --egressQueued;
+    // 高低水位之间留出间隔，避免在阈值附近反复开关
+    if (ingressPaused && egressQueued <= EGRESS_LOW_WATER) {
+        setIngress(false);
+    }
+}
+
+void IReactor::mqtt_publish_cb(struct mosquitto* m, void* userdata, int mid)
+{
+    static_cast<IReactor*>(userdata)->egressDone();
+}
+
+void IReactor::resetEgress()
+{
+    egressQueued = 0;
+    if (ingressPaused) setIngress(false);
+}
+
+void IReactor::setIngress(bool paused)
+{
+    ingressPaused = paused;
+    if (paused) ++stats.ingressPauses;
+
+    std::vector<int> conns;
+    for (auto& kv : handler) {
+        if (kv.second->kind() == HandlerKind::Udp || kv.second->kind() == HandlerKind::Ring) {
+            // UDP 套接字和环不屏蔽事件，暂停期间来的通知直接忽略，恢复时挂到就绪链表补收
+            if (!paused) markReady(kv.first);
+            continue;
+        }
+        if (kv.second->kind() != HandlerKind::Connection) continue;
+        // 限速推迟中的连接由自己的定时器恢复
+        if (!paused && static_cast<ConnectionHandler*>(kv.second.get())->isThrottled()) continue;
+        if (paused) pauseRead(kv.first);
+        else resumeRead(kv.first);
+        conns.push_back(kv.first);
+    }
+    if (paused) return;
+
+    // 解析暂停期间存下的数据；解析会 publish，可能再次触发暂停，也可能关闭连接，所以先拷出 fd 再逐个查
+    for (int fd : conns) {
+        if (ingressPaused) break;
+        auto it = handler.find(fd);
+        if (it == handler.end()) continue;
+        std::shared_ptr<EventHandler> h = it->second;
+        static_cast<ConnectionHandler*>(h.get())->resumeParse(fd);
+    }
+}
+
+void IReactor::attachConnection(int cfd)
+{
+    // SOCK_SEQPACKET 一次读只取一条记录，处理器要知道没读满不代表内核里已经空了
+    int type = SOCK_STREAM;
+    socklen_t len = sizeof(type);
+    getsockopt(cfd, SOL_SOCKET, SO_TYPE, &type, &len);
+
+    if (coSessions) {
+        auto session = std::make_shared<SensorSession>(this, &protocol);
+        session->setRecords(type == SOCK_SEQPACKET);
+        handler[cfd] = session;
+        session->start(cfd);
+        return;
+    }
+    auto conn = std::make_shared<ConnectionHandler>(this, &protocol);
+    conn->setRecords(type == SOCK_SEQPACKET);
+    handler[cfd] = conn;
+}
+
+void IReactor::attachMqtt(int fd, const std::shared_ptr<MqttHandler>& ptr, struct mosquitto* mosq)
+{
+    std::shared_ptr<MqttHandler> p = ptr;
+    if (!p) {
+        p = std::make_shared<MqttHandler>(this, &protocol);
+        p->setMosq(mosq); // 只有新创建时才设置，旧对象已经持有了
+    }
+    else
+    {
+        cancelTimer(p->getTimer());
+    }
+    TimeWheelNode* node = addNewTimer(getWheel(), mqtt_heartbeat_cb, 60000, p.get());
+    p->setTimer(node);
+    p->setFd(fd);
+
+    handler[fd] = p;
+}
+
+const LoopStats& IReactor::getStats()
+{
+    // 接收缓冲区池是线程局部的，取快照时顺带读一下
+    stats.rxLent = Buffer::lentCount();
+    stats.rxPooled = Buffer::pooledCount();
+    const Protocol::Errors& errors = protocol.errors();
+    stats.protoResyncs = errors.resyncs;
+    stats.protoSkipped = errors.skipped;
+    stats.protoChecksum = errors.checksum;
+    stats.protoDatagrams = errors.datagrams;
+    return stats;
+}
+
+void IReactor::bindDevice(uint8_t id, int fd)
+{
+    // 同一连接的后续帧只比较一次；设备在别的 Reactor 上的连接断开时会清掉 deviceOwner，这时要补回登记
+    if (deviceFd[id] == fd && deviceOwner[id].load(std::memory_order_relaxed) == this) return;
 
-            // 3. ٴμ飬handleRead ܴ remove
-            if (handler.find(fd) != handler.end() && (revents & EPOLLOUT)) {
-                handler[fd]->handleWrite(fd);
-            }
+    auto conn = dynamic_cast<ConnectionHandler*>(handlerOf(fd));
+    if (!conn) return;
+    conn->addDevice(id);//一个采集器可能转发多个设备的帧，每个都要记下
+    deviceFd[id] = fd;
+    deviceOwner[id].store(this, std::memory_order_release);
+}
 
-            // 4. 
-            if (handler.find(fd) != handler.end() && (revents & (EPOLLERR | EPOLLHUP))) {
-                close(fd);
-                remove(fd);
-            }
+void IReactor::routeCommand(uint8_t id, const char* payload, size_t len)
+{
+    uint64_t received = LoopStats::now();
+    if (len > COMMAND_MAX_LEN) {
+        std::cerr << "Command for device " << (int)id << " dropped: " << len << " bytes exceeds limit" << std::endl;
+        ++stats.commandDrops;
+        return;
+    }
+
+    IReactor* owner = deviceOwner[id].load(std::memory_order_acquire);
+    if (!owner) {
+        std::cerr << "Command for device " << (int)id << " dropped: device not connected" << std::endl;
+        ++stats.commandDrops;
+        return;
+    }
+    if (owner == this) {
+        deliverCommand(id, payload, len, received);
+        return;
+    }
+
+    // libmosquitto 回调返回后载荷就释放了，跨线程要拷一份
+    std::string cmd(payload, len);
+    owner->queueInLoop([owner, id, cmd = std::move(cmd), received] {
+        owner->deliverCommand(id, cmd.data(), cmd.size(), received);
+    });
+}
+
+void IReactor::deliverCommand(uint8_t id, const char* payload, size_t len, uint64_t received)
+{
+    // 投递途中设备可能已经断开或换了 Reactor
+    int fd = deviceFd[id];
+    auto conn = fd < 0 ? nullptr : dynamic_cast<ConnectionHandler*>(handlerOf(fd));
+    if (!conn) {
+        std::cerr << "Command for device " << (int)id << " dropped: device disconnected" << std::endl;
+        ++stats.commandDrops;
+        return;
+    }
+    conn->queueCommand(payload, len, received);
+    update(fd, EPOLLIN | EPOLLOUT);
+}
+
+void IReactor::reply(int fd, const char* payload, size_t len)
+{
+    auto conn = dynamic_cast<ConnectionHandler*>(handlerOf(fd));
+    if (!conn) return;
+    conn->queueFrame(payload, len);
+    update(fd, EPOLLIN | EPOLLOUT);
+}
+
+bool IReactor::admitDevice(uint8_t id)
+{
+    if (rateLimit.deviceRate == 0) return true;
+    if (deviceBuckets[id].take(loopTime(), rateLimit.deviceRate, rateLimit.deviceBurst)) return true;
+    ++stats.rateDrops;
+    return false;
+}
+
+bool IReactor::admitConnection(TokenBucket& bucket)
+{
+    if (rateLimit.connRate == 0) return true;
+    return bucket.take(loopTime(), rateLimit.connRate, rateLimit.connBurst);
+}
+
+void IReactor::attachUdp(int fd)
+{
+    handler[fd] = std::make_shared<UdpHandler>(this, &protocol);
+}
+
+void IReactor::attachLocal(int fd, bool ring)
+{
+    handler[fd] = std::make_shared<AcceptHandler>(this, &protocol, ring ? Listen::Ring : Listen::Local);
+}
+
+void IReactor::attachRing(int fd, const std::shared_ptr<RingHandler>& h)
+{
+    handler[fd] = h;
+}
+
+void IReactor::doReadyList()
+{
+    if (ingressPaused || readyFds.empty()) return;//暂停期间挂起的连接留到恢复后再读
+
+    // 先换出来，本轮 handleRead 再次用完预算的连接留到下一轮
+    readyScratch.assign(readyFds.begin(), readyFds.end());
+    readyFds.clear();
+    for (int fd : readyScratch) {
+        auto it = handler.find(fd);
+        if (it == handler.end()) continue;
+        std::shared_ptr<EventHandler> h = it->second;
+        h->handleRead(fd);
+        stats.callback(h->kind());
+    }
+}
+
+void IReactor::detach(int cfd)
+{
+    auto it = handler.find(cfd);
+    if (it == handler.end()) return;
+    if (auto conn = dynamic_cast<ConnectionHandler*>(it->second.get())) {
+        load.fetch_sub(1, std::memory_order_relaxed);
+        // 这条连接上报过的所有设备都要撤销，否则 fd 号被新连接复用后命令会发给它
+        const auto& devices = conn->getDevices();
+        for (int id = 0; devices.any() && id < DEVICE_MAX; ++id) {
+            if (!devices.test(id) || deviceFd[id] != cfd) continue;
+            // 设备可能已经在别的 Reactor 或别的连接上重连，只撤销仍指向自己的登记
+            deviceFd[id] = -1;
+            IReactor* self = this;
+            deviceOwner[id].compare_exchange_strong(self, nullptr, std::memory_order_acq_rel);
         }
     }
-}
\ No newline at end of file
+    else if (auto ring = dynamic_cast<RingHandler*>(it->second.get())) {
+        if (cfd == ring->getControlFd()) load.fetch_sub(1, std::memory_order_relaxed);
+    }
+    readyFds.erase(cfd);//fd 号随后可能被新连接复用
+    handler.erase(it);
+}
@@ -1,32 +1,176 @@
 #pragma once
-#include <sys/epoll.h>
+#include <sys/epoll.h>//EPOLLIN / EPOLLOUT 作为各后端通用的关注事件掩码
 #include <unordered_map>
-#include <memory>//ָ
+#include <unordered_set>
+#include <memory>//智能指针
+#include <vector>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <cstdint>
+#include <mosquitto.h>
+#include "cJSON.h"
 #include "eventhandler.h"
 #include "timewheel.h"
+#include "memorypool.h"
+#include "protocol.h"
+#include "mpscqueue.h"
+#include "loopstats.h"
+#include "tokenbucket.h"
 
-#define MAX_EVENTS 1024
-#define BUFFER_SIZE 64
+#define EGRESS_HIGH_WATER 4096 // MQTT 出口队列里还没写出去的消息数达到这个值时停止读传感器连接
+#define EGRESS_LOW_WATER 1024 // 回落到这个值以下恢复读取
+#define DEVICE_MAX 256 // deviceId 只有 1 个字节，下行路由表按下标直接开满
+#define COMMAND_MAX_LEN 4096 // 单条下行命令载荷的上限
 
+class MqttHandler;
+class RingHandler;
 
+using Task = std::function<void()>;
+
+// 主从 Reactor 模式下新连接的分配策略
+enum class Balance : char { RoundRobin, LeastLoaded };
+
+// I/O 多路复用后端，启动时选择
+enum class Backend : char { Epoll, Uring };
+
+
+// Reactor 接口：与后端无关的状态（处理器表、时间轮、内存池前端、跨线程移交队列）放在这里，
+// 具体怎么等待事件、怎么读写由 epoll / io_uring 后端各自实现
 class IReactor
 {
-private:
-    int sockfd;//׽
-    int efd;//epoll
-    epoll_event ev, events[MAX_EVENTS];//epoll¼
-    std::unordered_map<int, std::shared_ptr<EventHandler>> handler;//Ӵϣ
-    
+protected:
+    int sockfd;//监听套接字，主从模式下的从 Reactor 为 -1
+    struct mosquitto* mosq;
+    std::unordered_map<int, std::shared_ptr<EventHandler>> handler;//连接处理器哈希表
+    Wheel wheel;//每个 Reactor 独占一个时间轮，只在所属线程内访问
+    Protocol protocol;
+
+    cJSON_Hooks hooks;
+
+    int wakeupfd;//eventfd，其他线程投递数据后用它唤醒本 Reactor
+    std::atomic<bool> wakeupPending{ false };//已写过 eventfd 且还没被取走，期间的投递不必再写
+    MpscQueue<int> pendingFds;//主 Reactor 移交过来、尚未注册的连接
+    MpscQueue<Task> pendingTasks;//其他线程投递、等待在本线程执行的任务
+    std::thread::id loopThread;//构造 Reactor 的线程即事件循环线程
+
+    LoopStats stats;
+    int busyPollUs = 0;//大于 0 时进入阻塞等待前先空转这么多微秒
+    bool coSessions = false;//新连接用协程会话（SensorSession）处理
+    std::atomic<int> load{ 0 };//本 Reactor 承载的连接数，供主 Reactor 选择从 Reactor
+
+    std::vector<IReactor*> subReactors;//非空时本 Reactor 只负责 accept，连接交给从 Reactor
+    Balance balance = Balance::LeastLoaded;
+    size_t next = 0;//轮询下标
+    std::vector<IReactor*> localPeers;//本机连接的分发目标
+
+    size_t egressQueued = 0;//已 publish、libmosquitto 还没写进 socket 的消息数
+    bool ingressPaused = false;//出口积压超过高水位，所有连接停止读取
+
+    std::unordered_set<int> readyFds;//读预算用完、内核里可能还有数据的连接，下一轮接着读
+    std::vector<int> readyScratch;
+
+    // 下行路由：deviceOwner 记录设备当前连在哪个 Reactor 上，进程内共享；deviceFd 是各 Reactor 自己的 deviceId 到 fd 的映射
+    // 两张表都按 deviceId 直接下标访问，路由不用遍历连接
+    int deviceFd[DEVICE_MAX];
+    static std::atomic<IReactor*> deviceOwner[DEVICE_MAX];
+
+    RateLimit rateLimit;
+    TokenBucket deviceBuckets[DEVICE_MAX];//设备在哪个 Reactor 上就用哪个 Reactor 的桶
+
 public:
     explicit IReactor(int s, struct mosquitto* m);
-    ~IReactor();
+    virtual ~IReactor();
+    IReactor(const IReactor&) = delete;
+    IReactor& operator=(const IReactor&) = delete;
+
+    virtual void loop() = 0;//主事件循环
+    virtual void mqttLoop() = 0;//带定时器的事件循环
+    virtual void register_(int cfd, uint32_t mode) = 0;//注册连接套接字
+    virtual void mqttRegister(int fd, uint32_t mode, const std::shared_ptr<MqttHandler>& ptr, struct mosquitto* mosq) = 0;
+    virtual void remove(int cfd) = 0;//注销套接字，调用者负责 close
+    virtual void update(int cfd, uint32_t mode) = 0;//修改关注的事件（EPOLLIN / EPOLLOUT）
+    virtual void udpRegister(int fd) = 0;//注册 UDP 上报套接字
+    virtual void localRegister(int fd, bool ring) = 0;//注册 AF_UNIX 监听套接字，ring 为 true 时是共享内存环的控制套接字
+    virtual void ringRegister(int fd, const std::shared_ptr<RingHandler>& h) = 0;//注册共享内存环的控制连接或 eventfd
+
+    void newConnection(int cfd);//拿到新连接后调用，按模式本地注册或移交从 Reactor
+    void setSubReactors(const std::vector<IReactor*>& subs, Balance b);
+    // AF_UNIX 没有 SO_REUSEPORT 分流：reuseport 模式下由一个 Reactor 统一 accept，按均衡策略分给 peers（含自己）
+    void newLocalConnection(int cfd);//没有设置 peers 时同 newConnection
+    void setLocalPeers(const std::vector<IReactor*>& peers, Balance b);
+    void newRingConnection(int cfd);//共享内存环的控制连接：和本机连接一样选目标 Reactor，由它建环
+    void openRing(int cfd);//建环并把两个 fd 注册到本 Reactor，失败时关闭 cfd
+    void queueConnection(int cfd);//线程安全：把连接移交给本 Reactor
+
+    // 跨线程任务：处理器表、多路复用器和时间轮都只能在本 Reactor 线程访问，
+    // 其他线程要操作它们时把任务投递过来。投递会分配内存，不能在信号处理函数里直接调用
+    bool isInLoopThread() { return std::this_thread::get_id() == loopThread; }
+    void runInLoop(Task task);//线程安全：已在本线程则立即执行，否则排队
+    void queueInLoop(Task task);//线程安全：总是排到下一次唤醒时执行
+
+    // 后端实现：停止 / 恢复从连接读取，发送方向不受影响
+    virtual void pauseRead(int cfd) = 0;
+    virtual void resumeRead(int cfd) = 0;
+    void doPendingWork();//eventfd 可读时调用：注册移交的连接，执行排队的任务
+
+    virtual void setBusyPoll(int us) { busyPollUs = us; }//在进入事件循环之前调用
+    void setCoSessions(bool on) { coSessions = on; }
+    void setRateLimit(const RateLimit& r) { rateLimit = r; }
+    const LoopStats& getStats();//只能在本 Reactor 线程调用，其他线程用 runInLoop 取快照
+    int getLoad() { return load.load(std::memory_order_relaxed); }
 
-    virtual void loop();//¼ѭ
-    virtual void register_(int cfd, uint32_t mode);//ע׽ֵepoll
-    void remove(int cfd);//ر׽
-    void update(int cfd, uint32_t mode);//epoll׽
+    void markReady(int cfd) { readyFds.insert(cfd); }//连接用完本轮读预算时调用
+    bool hasReady() { return !ingressPaused && !readyFds.empty(); }//有待续读的连接时事件循环不能阻塞等待
+    bool isIngressPaused() { return ingressPaused; }
+    EventHandler* handlerOf(int fd)//fd 当前的处理器，未注册返回 nullptr
+    {
+        auto it = handler.find(fd);
+        return it == handler.end() ? nullptr : it->second.get();
+    }
+    void doReadyList();//续读上一轮挂起的连接
 
+    struct mosquitto* getMosq() { return mosq; }
     int getSockfd() { return sockfd; }
-    static Wheel* getWheel() { static Wheel wheel; return &wheel; }//ȡʱ
+    Wheel* getWheel() { return &wheel; }//获取时间轮
 
-};
\ No newline at end of file
+    // 出口反压：MQTT 发不动时停止读传感器，让 TCP 流控把压力推回设备端，网关内存保持有界
+    // libmosquitto 没在跑自己的线程时 publish 内部会直接尝试写 socket，写出回调可能在 publish 返回前就来了，
+    // 所以要先计数再 publish，失败了再退回
+    void egressQueue();//publish 之前调用，达到高水位时停止读取
+    void egressDone();//写出回调或 publish 失败时调用，回落到低水位时恢复读取
+    void resetEgress();//MQTT 重连：libmosquitto 丢弃了还没写出的 QoS 0 消息，计数清零
+
+    // 下行命令：订阅命令主题的客户端收到消息后调用 routeCommand，按 deviceOwner 投递到设备所在的 Reactor，
+    // 在那里追加到连接的发送缓冲区，由写事件发出；延迟从收到命令计到写进 socket
+    void bindDevice(uint8_t id, int fd);//收到设备的合法帧时调用，记录设备所在的连接
+    void routeCommand(uint8_t id, const char* payload, size_t len);//在订阅命令主题的 Reactor 线程里调用
+    void commandSent(uint64_t ns) { stats.command(ns); }
+    void reply(int fd, const char* payload, size_t len);//协议层给连接的应答（握手确认），和下行命令一样加长度头
+
+    // 限速：令牌按本轮事件循环被唤醒的时刻补充，逐帧判断不取时间
+    uint64_t loopTime() { return stats.woke; }//本轮事件循环被唤醒的时刻
+    bool admitDevice(uint8_t id);//超速返回 false，调用者丢弃这一帧
+    bool admitConnection(TokenBucket& bucket);//超速返回 false，调用者停止解析并推迟
+    uint32_t throttleMs(const TokenBucket& bucket) { return bucket.waitMs(rateLimit.connRate); }
+    void connectionThrottled() { ++stats.rateDefers; }
+    void ringConsumed(size_t n) { stats.ringRecords += n; }
+
+    static void mqtt_heartbeat_cb(void* args);
+    static void mqtt_publish_cb(struct mosquitto* m, void* userdata, int mid);//QoS 0 消息写进 socket 后回调
+
+protected:
+    // 后端共用的处理器表维护
+    void attachConnection(int cfd);
+    void wakeup();
+    void attachMqtt(int fd, const std::shared_ptr<MqttHandler>& ptr, struct mosquitto* mosq);
+    void attachUdp(int fd);
+    void attachLocal(int fd, bool ring);
+    void attachRing(int fd, const std::shared_ptr<RingHandler>& h);
+    void detach(int cfd);
+
+private:
+    void setIngress(bool paused);//对所有连接调用 pauseRead / resumeRead
+    IReactor* pickReactor(const std::vector<IReactor*>& list);//按 balance 选一个目标
+    void deliverCommand(uint8_t id, const char* payload, size_t len, uint64_t received);//在设备所在的 Reactor 线程里执行
+};
@@ -3,31 +3,100 @@
 
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <cerrno>
 #include <cstdio>
 
+AcceptHandler::AcceptHandler(IReactor* r, Protocol* p, Listen l) : EventHandler(r, p), listen(l)
+{
+    idlefd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+}
+
+AcceptHandler::~AcceptHandler()
+{
+    if (idlefd != -1) close(idlefd);
+}
+
 void AcceptHandler::handleRead(int fd)
 {
-    while (1)
+    for (int n = 0; n < ACCEPT_BUDGET; ++n)
     {
-        struct sockaddr_in clientaddr;
-        socklen_t len = sizeof(clientaddr);
-        int clientfd = accept(reactor->getSockfd(), (struct sockaddr*)&clientaddr, &len);
+        // 一次系统调用完成 accept + 非阻塞 + CLOEXEC；对端地址用不上，AF_UNIX 的也一样不取
+        int clientfd = accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
         if (clientfd == -1)
         {
-            if (clientfd == -1)
-            {
-                // ؼ ""  ""
-                if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                    break; // ǰӣETģʽ˳
-                }
-                else {
-                    perror("accept error");
-                    break; // 󣺴ӡ־˳
-                }
+            // 关键：区分 "无新连接" 和 "真错误"
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return; // 正常：当前无新连接，ET模式下退出
+            }
+            else if (errno == EINTR || errno == ECONNABORTED || errno == EPROTO) {
+                continue; // 对端在握手完成后又断开之类，跳过这一个
+            }
+            else if (errno == EMFILE || errno == ENFILE) {
+                // 内核先分配 fd 再看队列，backlog 为空时也会报 EMFILE
+                if (!shed(fd)) return;
+                continue;
+            }
+            else {
+                perror("accept error");
+                return; // 真错误：打印日志并退出
             }
         }
-        set_nonblocking(clientfd);
-        reactor->register_(clientfd, EPOLLIN);
+        accepted(clientfd);
     }
-}
\ No newline at end of file
+
+    // 预算用完还没读到 EAGAIN，ET 不会再通知
+    reactor->markReady(fd);
+}
+
+bool AcceptHandler::shed(int fd)
+{
+    // 腾出预留 fd 接下队首的连接立刻关掉，对端收到 FIN 后会退避重连，
+    // 否则这个连接一直留在 backlog 里，ET 模式下监听套接字再也不会触发
+    if (idlefd == -1) {
+        perror("accept error");
+        return false; // 没有预留 fd 可腾，只能等下一次唤醒
+    }
+    close(idlefd);
+    int clientfd = accept(fd, NULL, NULL);
+    if (clientfd != -1) close(clientfd);
+    idlefd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    if (clientfd == -1) return false;
+    fprintf(stderr, "accept: too many open files, dropped one connection\n");
+    return true;
+}
+
+void AcceptHandler::accepted(int clientfd)
+{
+    // 本机连接没有 Nagle、keepalive 这些概念，缓冲区大小由发送方的 SO_SNDBUF 决定
+    if (listen == Listen::Ring) {
+        reactor->newRingConnection(clientfd);
+        return;
+    }
+    if (listen == Listen::Local) {
+        reactor->newLocalConnection(clientfd);
+        return;
+    }
+    set_client_options(clientfd);
+    reactor->newConnection(clientfd);
+}
+
+void set_client_options(int fd)
+{
+    int opt = 1;
+    // 传感器帧很小，不能让 Nagle 攒包
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+
+    // 基站掉电时连接不会收到 FIN，靠 keepalive 尽早回收
+    setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &opt, sizeof(opt));
+    int idle = KEEPALIVE_IDLE, intvl = KEEPALIVE_INTVL, cnt = KEEPALIVE_CNT;
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle));
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &intvl, sizeof(intvl));
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &cnt, sizeof(cnt));
+
+    int rcvbuf = CLIENT_RCVBUF, sndbuf = CLIENT_SNDBUF;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+}
@@ -3,10 +3,32 @@
 
 
 
+#define ACCEPT_BUDGET 64 // 每次唤醒最多 accept 的连接数，剩下的挂到就绪链表下一轮再收
+
+// 连接级套接字参数，accept 时设置
+#define CLIENT_RCVBUF 65536
+#define CLIENT_SNDBUF 16384
+#define KEEPALIVE_IDLE 60 // 空闲多少秒后开始探测
+#define KEEPALIVE_INTVL 10
+#define KEEPALIVE_CNT 3
+
+// 监听套接字的种类：TCP、AF_UNIX 数据连接、共享内存环的控制连接
+enum class Listen : char { Tcp, Local, Ring };
+
 class AcceptHandler : public EventHandler
 {
+private:
+    int idlefd;//预留的空闲 fd，EMFILE 时腾出来接下一个连接再关掉，避免积压的连接把监听套接字卡死
+    Listen listen;//AF_UNIX 的新连接不设 TCP 参数
+
 public:
-    void handleRead(int fd) override;//overrideŻ顣
-    explicit AcceptHandler(Reactor* r, Protocol* p) : EventHandler(r, p) {}
+    void handleRead(int fd) override;//加上override，编译器才会检查。
+    explicit AcceptHandler(IReactor* r, Protocol* p, Listen l = Listen::Tcp);
+    ~AcceptHandler();
     void handleWrite(int fd) override {}
-};
\ No newline at end of file
+    HandlerKind kind() const override { return HandlerKind::Accept; }
+    bool shed(int fd);//fd 耗尽时丢弃一个待接受的连接，backlog 已空时返回 false
+    void accepted(int clientfd);//设置连接参数后交给 Reactor，两个后端拿到新连接都走这里
+};
+
+void set_client_options(int fd);
\ No newline at end of file
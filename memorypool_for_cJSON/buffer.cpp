@@ -0,0 +1,161 @@
+#include "buffer.h"
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <algorithm>
+#include <sys/uio.h>
+
+
+namespace {
+
+// 每个线程一个空闲块链表，空闲块的开头存 next 指针；线程退出时释放
+struct BlockCache
+{
+    struct Node { Node* next; };
+    Node* list = nullptr;
+    size_t count = 0;
+    size_t lent = 0;
+
+    ~BlockCache()
+    {
+        while (list) {
+            Node* next = list->next;
+            free(list);
+            list = next;
+        }
+    }
+};
+
+thread_local BlockCache blockCache;
+
+char* borrowStorage(size_t n)
+{
+    ++blockCache.lent;
+    if (n == BUFFER_BLOCK_SIZE && blockCache.list) {
+        BlockCache::Node* node = blockCache.list;
+        blockCache.list = node->next;
+        --blockCache.count;
+        return reinterpret_cast<char*>(node);
+    }
+    return static_cast<char*>(malloc(n));
+}
+
+void returnStorage(char* p, size_t n)
+{
+    --blockCache.lent;
+    if (n != BUFFER_BLOCK_SIZE || blockCache.count >= BUFFER_POOL_MAX) {
+        free(p);
+        return;
+    }
+    BlockCache::Node* node = reinterpret_cast<BlockCache::Node*>(p);
+    node->next = blockCache.list;
+    blockCache.list = node;
+    ++blockCache.count;
+}
+
+}
+
+
+size_t Buffer::lentCount()
+{
+    return blockCache.lent;
+}
+
+size_t Buffer::pooledCount()
+{
+    return blockCache.count;
+}
+
+void Buffer::retrieve(size_t n)
+{
+    if (n >= size()) {
+        // 读空了直接归零，下次追加不用整理
+        retrieveAll();
+        return;
+    }
+    readIndex += n;
+}
+
+void Buffer::release()
+{
+    if (!empty() || !buf) return;
+    freeStorage();
+}
+
+void Buffer::freeStorage()
+{
+    if (!buf) return;
+    returnStorage(buf, capacity);
+    buf = nullptr;
+    capacity = 0;
+    retrieveAll();
+}
+
+void Buffer::append(const char* src, size_t n)
+{
+    ensureWritable(n);
+    memcpy(beginWrite(), src, n);
+    hasWritten(n);
+}
+
+ssize_t Buffer::readFd(int fd, bool* more)
+{
+    *more = false;
+    ensureWritable(readHint);
+
+    char extra[BUFFER_EXTRA_SIZE];
+    size_t room = writable();
+    struct iovec vec[2];
+    vec[0].iov_base = beginWrite();
+    vec[0].iov_len = room;
+    vec[1].iov_base = extra;
+    vec[1].iov_len = sizeof(extra);
+    ssize_t n = readv(fd, vec, 2);
+    if (n <= 0) return n;
+    *more = (size_t)n == room + sizeof(extra);
+
+    if ((size_t)n <= room) {
+        hasWritten(n);
+    }
+    else {
+        hasWritten(room);
+        append(extra, n - room);
+    }
+
+    if ((size_t)n >= room) {
+        readHint = std::min<size_t>(readHint * 2, BUFFER_MAX_HINT);
+    }
+    else if ((size_t)n < readHint / 4) {
+        readHint = std::max<size_t>(readHint / 2, BUFFER_MIN_HINT);
+    }
+    return n;
+}
+
+void Buffer::ensureWritable(size_t n)
+{
+    if (writable() >= n) return;
+
+    size_t readable = size();
+    if (buf && readIndex + writable() >= n) {
+        // 开头已消费的空间加上尾部空闲够用：把剩下的半帧挪回开头，不扩容
+        memmove(buf, buf + readIndex, readable);
+    }
+    else {
+        // 没有存储时借一块；一块放不下的按两倍扩，超出一块的部分不走池
+        size_t want = std::max(capacity * 2, readable + n);
+        if (want <= BUFFER_BLOCK_SIZE) want = BUFFER_BLOCK_SIZE;
+        char* bigger = borrowStorage(want);
+        if (!bigger) {
+            perror("Buffer malloc");
+            abort();
+        }
+        if (buf) {
+            memcpy(bigger, buf + readIndex, readable);
+            returnStorage(buf, capacity);
+        }
+        buf = bigger;
+        capacity = want;
+    }
+    readIndex = 0;
+    writeIndex = readable;
+}
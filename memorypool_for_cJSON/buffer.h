@@ -0,0 +1,59 @@
+#pragma once
+#include <cstddef>
+#include <sys/types.h>
+
+#define BUFFER_BLOCK_SIZE 4096 // 池里每块的大小，也是借用时的起始容量
+#define BUFFER_POOL_MAX 1024 // 每个线程缓存的空闲块上限，超出的还给系统
+#define BUFFER_MIN_HINT 256 // readFd 预留空间的自适应范围
+#define BUFFER_MAX_HINT 16384
+#define BUFFER_EXTRA_SIZE 65536 // readFd 栈上溢出区，一次 readv 最多多读这么多
+
+
+// 读写下标字节缓冲区
+// [0, readIndex) 是已经消费掉的，[readIndex, writeIndex) 是待解析的数据，[writeIndex, size) 是空闲空间
+// 消费只移动 readIndex，不搬数据；追加时空闲空间不够才把待解析数据挪回开头（整理），仍不够再扩容
+// 每个字节最多被整理搬一次，逐帧消费整个缓冲区是线性的
+// 存储按需借用：第一次写入时从本线程的块池取一块，数据解析完后 release 还回去，空闲连接不占缓冲区内存
+// 超过一块的容量直接 malloc，还回时释放
+class Buffer
+{
+public:
+    Buffer() = default;
+    ~Buffer() { freeStorage(); }
+    Buffer(const Buffer&) = delete;
+    Buffer& operator=(const Buffer&) = delete;
+
+    size_t size() const { return writeIndex - readIndex; }//待解析的字节数
+    bool empty() const { return writeIndex == readIndex; }
+    const char* data() const { return buf + readIndex; }
+
+    void retrieve(size_t n);//消费开头 n 个字节
+    void retrieveAll() { readIndex = writeIndex = 0; }
+    void release();//没有待解析数据时把存储还给池
+
+    void append(const char* src, size_t n);
+
+    // 直接往缓冲区里读：先 ensureWritable，读完再 hasWritten
+    void ensureWritable(size_t n);
+    char* beginWrite() { return buf + writeIndex; }
+    size_t writable() const { return capacity - writeIndex; }
+    void hasWritten(size_t n) { writeIndex += n; }
+
+    // 一次 readv 读进缓冲区的空闲空间，放不下的进栈上溢出区再追加；
+    // 预留空间按最近一次读到的量自适应：读满就加倍，读得很少就减半
+    // 返回值同 readv，出错时 errno 保持不变；more 置为两段空间是否都读满（内核里可能还有数据）
+    ssize_t readFd(int fd, bool* more);
+
+    // 本线程借出的存储数和池里缓存的空闲块数，用于统计
+    static size_t lentCount();
+    static size_t pooledCount();
+
+private:
+    void freeStorage();
+
+    char* buf = nullptr;
+    size_t capacity = 0;
+    size_t readIndex = 0;
+    size_t writeIndex = 0;
+    size_t readHint = BUFFER_MIN_HINT;
+};
@@ -0,0 +1,119 @@
+#include "coconnectionhandler.h"
+#include "reactor.h"
+
+#include <unistd.h>
+
+
+CoConnectionHandler::~CoConnectionHandler()
+{
+    // 连接在协程挂起期间被关闭：撤销定时器，协程帧由 task 析构时销毁
+    disarmTimer();
+}
+
+void CoConnectionHandler::start(int fd)
+{
+    sockfd = fd;
+    task = run(fd);
+    resume();
+}
+
+void CoConnectionHandler::resume()
+{
+    waiting = Wait::None;
+    task.resume();
+    if (task.done()) {
+        // 会话走完：注销后本对象随即析构，之后不能再访问成员
+        int fd = sockfd;
+        reactor->remove(fd);
+        close(fd);
+    }
+}
+
+void CoConnectionHandler::onData(int fd)
+{
+    if (waiting == Wait::Read) {
+        disarmTimer();
+        timedOut = false;
+        resume();
+    }
+    else {
+        unread = true;
+    }
+}
+
+void CoConnectionHandler::onDrained(int fd)
+{
+    if (waiting == Wait::Write) {
+        resume();
+    }
+}
+
+void CoConnectionHandler::armTimer(int ms)
+{
+    timer = addNewTimer(reactor->getWheel(), onTimer, ms, this);
+}
+
+void CoConnectionHandler::disarmTimer()
+{
+    if (timer) {
+        cancelTimer(timer);
+        timer = nullptr;
+    }
+}
+
+void CoConnectionHandler::onTimer(void* arg)
+{
+    auto self = static_cast<CoConnectionHandler*>(arg);
+    self->timer = nullptr;//节点由时间轮在回调返回后释放
+    self->timedOut = true;
+    self->resume();
+}
+
+bool CoConnectionHandler::ReadAwaiter::await_ready()
+{
+    // 协程忙别的事（sleep、write）期间到达的数据不需要再等
+    if (self->unread) {
+        self->unread = false;
+        self->timedOut = false;
+        return true;
+    }
+    return false;
+}
+
+void CoConnectionHandler::ReadAwaiter::await_suspend(std::coroutine_handle<>)
+{
+    self->recvBuffer.release();//协程把能解析的都解析完才会等读，空了就还给池
+    self->waiting = Wait::Read;
+    self->timedOut = false;
+    if (timeoutMs > 0) {
+        self->armTimer(timeoutMs);
+    }
+}
+
+bool CoConnectionHandler::ReadAwaiter::await_resume()
+{
+    return !self->timedOut;
+}
+
+CoConnectionHandler::WriteAwaiter CoConnectionHandler::write(const char* data, size_t len)
+{
+    queueSend(data, len);
+    reactor->update(sockfd, EPOLLIN | EPOLLOUT);
+    return WriteAwaiter{ this };
+}
+
+bool CoConnectionHandler::WriteAwaiter::await_ready()
+{
+    return self->sendBuffer.size() < CO_WRITE_HIGH;
+}
+
+void CoConnectionHandler::WriteAwaiter::await_suspend(std::coroutine_handle<>)
+{
+    self->waiting = Wait::Write;
+}
+
+void CoConnectionHandler::SleepAwaiter::await_suspend(std::coroutine_handle<>)
+{
+    self->waiting = Wait::Sleep;
+    self->armTimer(ms);
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include "connectionhandler.h"
+#include "coroutine.h"
+
+#define CO_WRITE_HIGH 4096 // 发送缓冲区积压超过这个值时 write 挂起，直到全部发完
+
+struct TimeWheelNode;
+
+
+// 协程连接处理器：子类在 run 里用 co_await read / write / sleep 按顺序写协议流程，
+// 读写仍走 ConnectionHandler 的缓冲区，epoll 和 io_uring 两个后端都不需要改动
+// 协程只在本 Reactor 线程内恢复；co_return 后连接由处理器关闭，连接先断开时未执行完的协程帧随处理器一起销毁
+class CoConnectionHandler : public ConnectionHandler
+{
+protected:
+    struct ReadAwaiter
+    {
+        CoConnectionHandler* self;
+        int timeoutMs;
+        bool await_ready();
+        void await_suspend(std::coroutine_handle<>);
+        bool await_resume();//false 表示超时
+    };
+
+    struct WriteAwaiter
+    {
+        CoConnectionHandler* self;
+        bool await_ready();
+        void await_suspend(std::coroutine_handle<>);
+        void await_resume() {}
+    };
+
+    struct SleepAwaiter
+    {
+        CoConnectionHandler* self;
+        int ms;
+        bool await_ready() { return ms <= 0; }
+        void await_suspend(std::coroutine_handle<>);
+        void await_resume() {}
+    };
+
+    // 等到接收缓冲区里有还没看过的数据；timeoutMs < 0 表示不限时，超时返回 false
+    ReadAwaiter read(int timeoutMs = -1) { return ReadAwaiter{ this, timeoutMs }; }
+    // 追加到发送缓冲区并请求发送；积压超过 CO_WRITE_HIGH 时挂起到全部发完
+    WriteAwaiter write(const char* data, size_t len);
+    SleepAwaiter sleep(int ms) { return SleepAwaiter{ this, ms }; }
+
+    virtual CoTask run(int fd) = 0;//协议流程
+
+    void onData(int fd) override;
+    void onDrained(int fd) override;
+
+public:
+    explicit CoConnectionHandler(IReactor* r, Protocol* p) : ConnectionHandler(r, p) {}
+    ~CoConnectionHandler();
+
+    void start(int fd);//连接注册后调用，运行协程直到第一次挂起
+
+private:
+    enum class Wait : char { None, Read, Write, Sleep };
+
+    void resume();
+    void armTimer(int ms);
+    void disarmTimer();
+    static void onTimer(void* arg);
+
+    CoTask task;
+    int sockfd = -1;
+    Wait waiting = Wait::None;
+    bool unread = false;//上次 read 返回之后又来了数据
+    bool timedOut = false;
+    TimeWheelNode* timer = nullptr;
+};
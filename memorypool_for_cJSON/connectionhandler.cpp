@@ -1,5 +1,6 @@
 #include "connectionhandler.h"
 #include "reactor.h"
+#include "timewheel.h"
 
 #include <sys/socket.h>
 #include <unistd.h>
@@ -8,65 +9,200 @@
 #include <cstring>
 #include <arpa/inet.h>
 
-void ConnectionHandler::handleRead(int fd)//ֻݵЭ
+ConnectionHandler::~ConnectionHandler()
 {
-    char tmp[BUFFER_SIZE];
-    int count;
-    while ((count = recv(fd, tmp, BUFFER_SIZE - 1, 0)) > 0)
+    if (throttleTimer) cancelTimer(throttleTimer);
+}
+
+void ConnectionHandler::handleRead(int fd)//只负责读数据到缓冲区，不做协议解析
+{
+    // 出口积压或限速推迟期间不读，数据留在内核接收缓冲区里，满了由 TCP 窗口把设备挡住；恢复时后端会重新通知
+    if (reactor->isIngressPaused() || isThrottled()) return;
+
+    if (flooded(fd)) return;
+
+    // 直接读进接收缓冲区，放不下的由 readv 的栈上溢出区兜住，常见情况一次系统调用就读空
+    ssize_t count = 0;
+    size_t total = 0;
+    bool more = true;
+    while ((more || records || peerClosed) && total < READ_BUDGET)
     {
-        // ı 1ӻѹ 1KB ݻûΪЭ
-        if (recvBuffer.size() > 10240) {
-            std::cerr << "Flood protection: fd " << fd << " exceeded buffer limit. Closing." << std::endl;
-            reactor->remove(fd);
-            close(fd);
-            return;
-        }
-        recvBuffer.append(tmp, count);
+        // 没读满说明此刻内核里已经空了，不用再读一次等 EAGAIN；之后到达的数据会产生新的边沿
+        // 记录型套接字例外：一次只返回一条记录，后面排着的记录不会再产生边沿；
+        // 对端已关闭也例外：FIN 可能和数据一起到达，短读之后不会再有边沿，要接着读到 0
+        count = recvBuffer.readFd(fd, &more);
+        if (count <= 0) break;
+        total += count;
+    }
+
+    if (total >= READ_BUDGET)
+    {
+        // 预算用完但还没读到 EAGAIN，ET 不会再通知，挂到就绪链表下一轮接着读
+        reactor->markReady(fd);
+        onData(fd);
+        return;
+    }
+
+    if (count == 0)
+    {
+        handleClose(fd);
+        return;
     }
 
-    if (count == 0 || (count < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+    if (count < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
     {
         reactor->remove(fd);
         close(fd);
         return;
     }
 
-    mqttProcessMessages(fd);
+    onData(fd);
+}
+
+void ConnectionHandler::handleClose(int fd)
+{
+    // 对端关闭之前发来的数据先解析完；onData 里协程会话可能已经自行关闭，之后不能再碰成员
+    IReactor* r = reactor;
+    onData(fd);
+    if (r->handlerOf(fd) != this) return;
+
+    // 反压或限速中解析不完：先不关，恢复读取后会再次读到 EOF 回到这里
+    if (r->isIngressPaused() || isThrottled()) return;
+    r->remove(fd);
+    close(fd);
+}
+
+void ConnectionHandler::onData(int fd)
+{
+    if (!protocol->frameParse(recvBuffer, reactor, fd, &bucket, frameVersion)) throttle(fd);
+    recvBuffer.release();//解析完了就把缓冲区还给池，只剩半帧时继续留着
+}
+
+void ConnectionHandler::handleData(int fd, const char* data, size_t len)
+{
+    if (!append(fd, data, len)) return;
+    onData(fd);//反压期间 recv 已在取消途中，路上的数据只存不解析，恢复时由 resumeParse 补上
+}
+
+void ConnectionHandler::resumeParse(int fd)
+{
+    if (!recvBuffer.empty()) onData(fd);
+}
+
+void ConnectionHandler::throttle(int fd)
+{
+    if (isThrottled()) return;
+    reactor->connectionThrottled();
+    reactor->pauseRead(fd);
+    throttleFd = fd;
+    throttleTimer = addNewTimer(reactor->getWheel(), onThrottleTimer, reactor->throttleMs(bucket), this);
+}
+
+void ConnectionHandler::onThrottleTimer(void* arg)
+{
+    auto self = static_cast<ConnectionHandler*>(arg);
+    self->throttleTimer = nullptr;//节点由时间轮在回调返回后释放
+
+    // 全局反压期间不恢复，等 setIngress 统一恢复
+    int fd = self->throttleFd;
+    IReactor* r = self->reactor;
+    if (r->isIngressPaused()) return;
+
+    // 先解析攒下的帧，令牌又用完会重新推迟；全部解析掉才恢复读取，免得积压撞上 FLOOD_LIMIT
+    self->resumeParse(fd);
+    if (r->handlerOf(fd) != self || self->isThrottled() || r->isIngressPaused()) return;
+    r->resumeRead(fd);
+}
+
+void ConnectionHandler::queueSend(const char* data, size_t len)
+{
+    sendBuffer.append(data, len);
+    queuedBytes += len;
+}
+
+void ConnectionHandler::queueFrame(const char* payload, size_t len)
+{
+    // 和上行一样的帧格式：2 字节大端长度 + 载荷
+    uint16_t hdr = htons((uint16_t)len);
+    queueSend((const char*)&hdr, 2);
+    queueSend(payload, len);
+}
+
+void ConnectionHandler::queueCommand(const char* payload, size_t len, uint64_t received)
+{
+    queueFrame(payload, len);
+    commandStamps.push_back({ queuedBytes, received });
+}
+
+void ConnectionHandler::sent(size_t n)
+{
+    sentBytes += n;
+    if (commandStamps.empty() || commandStamps.front().end > sentBytes) return;
+
+    uint64_t now = LoopStats::now();
+    size_t done = 0;
+    while (done < commandStamps.size() && commandStamps[done].end <= sentBytes) {
+        reactor->commandSent(now - commandStamps[done].received);
+        ++done;
+    }
+    commandStamps.erase(commandStamps.begin(), commandStamps.begin() + done);
+    if (commandStamps.empty()) {
+        std::vector<CommandStamp>().swap(commandStamps);//空闲连接不留容量
+    }
+}
+
+bool ConnectionHandler::flooded(int fd)
+{
+    // 核心保护 1：如果单个连接积压超过 10KB 数据还没被解析，认为协议出错
+    // 反压和限速推迟期间的积压是正常的，上限是取消生效前内核接收缓冲区里的数据
+    if (recvBuffer.size() > FLOOD_LIMIT && !reactor->isIngressPaused() && !isThrottled()) {
+        std::cerr << "Flood protection: fd " << fd << " exceeded buffer limit. Closing." << std::endl;
+        reactor->remove(fd);
+        close(fd);
+        return true;
+    }
+    return false;
+}
+
+bool ConnectionHandler::append(int fd, const char* data, size_t len)
+{
+    if (flooded(fd)) return false;
+    recvBuffer.append(data, len);
+    return true;
 }
 
 void ConnectionHandler::handleWrite(int fd)
 {
     ssize_t count = 0;
-    while (sendBuffer.size() > 0)
+    while (!sendBuffer.empty())
     {
-        count = send(fd, sendBuffer.data(), sendBuffer.size(), 0);
-        if (count > 0)
-        {
-            sendBuffer.erase(0, count);
-        }
-        else
+        // 一次 sendmsg 带走头部多块，发出去的部分在链上直接消费掉
+        count = sendBuffer.sendTo(fd);
+        if (count <= 0)
         {
-            // ʱ count  0 (Զ˹ر)  -1 ( EAGAIN)
+            // 此时 count 可能是 0 (对端关闭) 或 -1 (出错或 EAGAIN)
             break;
         }
+        sent(count);
     }
 
-    // жϡꡱ׼ǿǷΪ
+    // 判断“发完”的最标准做法是看缓冲区是否为空
     if (sendBuffer.empty())
     {
-        reactor->update(fd, EPOLLIN); // ˣȡд
+        reactor->update(fd, EPOLLIN); // 发完了，取消写监控
+        onDrained(fd);
     }
     else
     {
-        // û꣬жΪ˻ǳ
+        // 没发完，判断是因为满了还是出错了
         if (count == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
         {
-            // ں˻ȷд¼
+            // 内核缓冲区满，确保监控了写事件
             reactor->update(fd, EPOLLIN | EPOLLOUT);
         }
         else
         {
-            // count == 0  errno 
+            // count == 0 或者真正的 errno 错误
             close(fd);
             reactor->remove(fd);
         }
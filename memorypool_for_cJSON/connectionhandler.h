@@ -1,19 +1,76 @@
 #pragma once
 #include <string>
+#include <vector>
+#include <bitset>
+#include <cstdint>
 #include "eventhandler.h"
+#include "buffer.h"
+#include "outputchain.h"
+#include "tokenbucket.h"
+#include "packet.h"
 
+#define READ_BUDGET 65536 // 每次唤醒单个连接最多读取的字节数，防止一个连接独占事件循环
+#define FLOOD_LIMIT 10240 // 解析不掉的积压超过这个值认为协议出错
+
+struct TimeWheelNode;
 
 
 class ConnectionHandler : public EventHandler
 {
+protected:
+    Buffer recvBuffer;//逐帧消费只移动读下标
+    OutputChain sendBuffer;//分块链表，部分发送只推进头块偏移
+
+    TokenBucket bucket;//连接限速
+    uint8_t frameVersion = FRAME_VERSION_FIXED;//握手协商出的帧格式版本
+
+    void queueSend(const char* data, size_t len);//追加到发送缓冲区，所有下行数据都从这里进
+    void throttle(int fd);//frameParse 因连接超速停下后调用：停止读取，攒够令牌后定时恢复
+
+    // 数据进入接收缓冲区后调用，默认直接按帧解析；协程会话改为唤醒等待读的协程
+    virtual void onData(int fd);
+    virtual void onDrained(int fd) {}//发送缓冲区全部发完
+
 private:
-    std::string recvBuffer;
-    std::string sendBuffer;
+    // 下行命令的写出时刻：按累计字节偏移记录，发送进度越过某条命令的末尾就算写出
+    struct CommandStamp
+    {
+        uint64_t end;//命令末尾在累计下行字节流里的偏移
+        uint64_t received;//收到命令的时刻
+    };
+    std::vector<CommandStamp> commandStamps;//没有在途命令时不占内存
+    uint64_t queuedBytes = 0;
+    uint64_t sentBytes = 0;
+    std::bitset<256> devices;//这条连接上报过的 deviceId（1 个字节），断开时要逐个撤销下行路由
+    TimeWheelNode* throttleTimer = nullptr;//非空表示限速推迟中
+    int throttleFd = -1;
+    bool records = false;//SOCK_SEQPACKET 连接：每次读一条记录，要读到 EAGAIN 才算读空
+    bool peerClosed = false;//收到过 EPOLLRDHUP：FIN 不会再产生边沿，要读到 0 才算读空
+
+    static void onThrottleTimer(void* arg);
+
+    bool flooded(int fd);//积压超限时关闭连接并返回 true
+    bool append(int fd, const char* data, size_t len);//追加到接收缓冲区，超限时关闭连接并返回 false
 
 public:
     void handleRead(int fd) override;
     void handleWrite(int fd) override;
-    explicit ConnectionHandler(Reactor* r, Protocol* p) : EventHandler(r,p) {}
+    HandlerKind kind() const override { return HandlerKind::Connection; }
+    void handleData(int fd, const char* data, size_t len);//io_uring 后端：数据已由内核读好，直接入缓冲区并解析
+    void handleClose(int fd);//对端正常关闭：解析完剩余数据再注销
+    OutputChain& getSendBuffer() { return sendBuffer; }
+    void notifyDrained(int fd) { onDrained(fd); }//io_uring 后端：发送完成事件里调用
+    void resumeParse(int fd);//出口反压解除后解析暂停期间存下的数据
+    void queueFrame(const char* payload, size_t len);//加 2 字节长度头追加到发送缓冲区
+    void queueCommand(const char* payload, size_t len, uint64_t received);//下行命令：按帧追加并记录写出时刻
+    void sent(size_t n);//n 字节已交给内核：统计其中写完的下行命令的延迟
+    bool isThrottled() { return throttleTimer != nullptr; }
+    void setRecords(bool on) { records = on; }
+    void setPeerClosed() { peerClosed = true; }//epoll 后端：对端关闭了写端
+    const std::bitset<256>& getDevices() { return devices; }
+    void addDevice(uint8_t id) { devices.set(id); }
+    explicit ConnectionHandler(IReactor* r, Protocol* p) : EventHandler(r,p) {}
+    ~ConnectionHandler();
 
 
 };
@@ -0,0 +1,49 @@
+#pragma once
+#include <coroutine>
+#include <exception>
+#include <cstddef>
+#include "memorypool.h"
+
+// 会话协程的返回类型
+// 创建后先挂起，由持有者调用 resume 启动；结束时停在 final_suspend，持有者用 done() 判断后回收，
+// 协程帧的生命周期完全由 CoTask 管理，析构时无论是否执行完都会销毁
+class CoTask
+{
+public:
+    struct promise_type
+    {
+        CoTask get_return_object() { return CoTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+
+        // 协程帧从本线程的内存池分配，挂起/恢复不会碰全局堆；
+        // 超过内存池块大小的帧由内存池自己退回 malloc
+        static void* operator new(size_t size) { return myMalloc(size); }
+        static void operator delete(void* ptr) { myFree(ptr); }
+    };
+
+    CoTask() = default;
+    explicit CoTask(std::coroutine_handle<promise_type> h) : handle(h) {}
+    ~CoTask() { if (handle) handle.destroy(); }
+
+    CoTask(CoTask&& other) noexcept : handle(other.handle) { other.handle = nullptr; }
+    CoTask& operator=(CoTask&& other) noexcept
+    {
+        if (this != &other) {
+            if (handle) handle.destroy();
+            handle = other.handle;
+            other.handle = nullptr;
+        }
+        return *this;
+    }
+    CoTask(const CoTask&) = delete;
+    CoTask& operator=(const CoTask&) = delete;
+
+    void resume() { if (handle && !handle.done()) handle.resume(); }
+    bool done() { return !handle || handle.done(); }
+
+private:
+    std::coroutine_handle<promise_type> handle;
+};
@@ -1,15 +1,17 @@
 #pragma once
+#include "loopstats.h"
 
-class Reactor;
+class IReactor;
 class Protocol;
 
 class EventHandler
 {
 public:
 	Protocol* protocol;
-    Reactor* reactor;
+    IReactor* reactor;
     virtual ~EventHandler() = default;
     virtual void handleRead(int fd) = 0;
     virtual void handleWrite(int fd) = 0;
-    explicit EventHandler(Reactor* r, Protocol* p) :reactor(r),protocol(p) {}
+    virtual HandlerKind kind() const { return HandlerKind::Other; }//事件循环统计按类型归类
+    explicit EventHandler(IReactor* r, Protocol* p) :reactor(r),protocol(p) {}
 };
\ No newline at end of file
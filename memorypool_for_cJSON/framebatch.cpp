@@ -0,0 +1,164 @@
+#include "framebatch.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define FRAME_SIMD 1
+#include <immintrin.h>
+#endif
+
+
+namespace {
+
+typedef size_t (*DecodeKernel)(const char* src, size_t n, FrameBatch& b);//处理开头的整组帧，返回处理了多少帧
+
+using Raw = SensorRawSchema;
+
+void decodeScalar(const char* src, size_t from, size_t n, FrameBatch& b)
+{
+    for (size_t i = from; i < n; ++i) {
+        const uint8_t* p = (const uint8_t*)src + i * FRAME_WIRE_SIZE + 2;
+        SensorReading r = Raw::Packet::decode(p);
+        b.id[i] = r.deviceId;
+        b.temp[i] = r.temp;
+        b.humi[i] = r.humi;
+        b.status[i] = r.status;
+        b.checksum[i] = r.checksum;
+        b.valid[i] = Raw::Packet::valid(p, r);
+    }
+}
+
+#ifdef FRAME_SIMD
+
+// 下面的重排表和求和是照定长帧的布局手写的，报文描述改了这里必须跟着改
+static_assert(Raw::DeviceId::offset == 0 && Raw::Temp::offset == 1 && Raw::Humi::offset == 3 && Raw::Status::offset == 5 && Raw::Checksum::offset == 6,
+    "SIMD shuffle assumes the SensorRawSchema field offsets");
+static_assert(Raw::Temp::endian == Endian::Big && Raw::Humi::endian == Endian::Big && Raw::Checksum::endian == Endian::Big,
+    "SIMD shuffle assumes big-endian 16-bit fields");
+static_assert(std::is_same_v<Raw::Check, Sum16<Raw::Checksum, &SensorReading::deviceId, &SensorReading::temp, &SensorReading::humi, &SensorReading::status>>,
+    "SIMD validation assumes the 16-bit sum checksum");
+
+// 每帧 8 字节载荷 id tH tL hH hL st cH cL，两帧拼成 16 字节后一次 pshufb 重排成 4 个小端 u16：
+// temp humi checksum (id | st << 8)，大端转小端就在这一步完成
+#define FRAME_SHUFFLE 2, 1, 4, 3, 7, 6, 0, 5, 10, 9, 12, 11, 15, 14, 8, 13
+
+// 4 个寄存器各装 2 帧 × 4 个字段，三轮 unpack 转置成 4 个寄存器各装 8 帧的同一字段
+// AVX2 的 unpack 按 128 位分半各做各的，两半各自是一组独立的 8 帧，同样适用
+#define FRAME_TRANSPOSE(P, r, T, H, C, IS) \
+    do { \
+        auto u0 = P##_unpacklo_epi16(r[0], r[1]), u1 = P##_unpackhi_epi16(r[0], r[1]); \
+        auto u2 = P##_unpacklo_epi16(r[2], r[3]), u3 = P##_unpackhi_epi16(r[2], r[3]); \
+        auto v0 = P##_unpacklo_epi16(u0, u1), v1 = P##_unpackhi_epi16(u0, u1); \
+        auto v2 = P##_unpacklo_epi16(u2, u3), v3 = P##_unpackhi_epi16(u2, u3); \
+        T = P##_unpacklo_epi64(v0, v2); \
+        H = P##_unpackhi_epi64(v0, v2); \
+        C = P##_unpacklo_epi64(v1, v3); \
+        IS = P##_unpackhi_epi64(v1, v3); \
+    } while (0)
+
+// 第 k 帧和第 k + 1 帧的载荷拼成一个 128 位寄存器
+#define FRAME_PAIR(p, k) \
+    _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)((p) + (k) * FRAME_WIRE_SIZE)), \
+                       _mm_loadl_epi64((const __m128i*)((p) + ((k) + 1) * FRAME_WIRE_SIZE)))
+
+__attribute__((target("sse4.1")))
+size_t decodeSse4(const char* src, size_t n, FrameBatch& b)
+{
+    const __m128i shuffle = _mm_setr_epi8(FRAME_SHUFFLE);
+    const __m128i lowByte = _mm_set1_epi16(0x00ff);
+    const __m128i one = _mm_set1_epi8(1);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const char* p = src + i * FRAME_WIRE_SIZE + 2;
+        __m128i r[4];
+        for (int k = 0; k < 4; ++k) {
+            r[k] = _mm_shuffle_epi8(FRAME_PAIR(p, 2 * k), shuffle);
+        }
+        __m128i T, H, C, IS;
+        FRAME_TRANSPOSE(_mm, r, T, H, C, IS);
+
+        // 校验和按 16 位回绕相加，正好是 epi16 加法的语义
+        __m128i id = _mm_and_si128(IS, lowByte);
+        __m128i st = _mm_srli_epi16(IS, 8);
+        __m128i sum = _mm_add_epi16(_mm_add_epi16(T, H), _mm_add_epi16(id, st));
+        __m128i ok = _mm_cmpeq_epi16(sum, C);
+
+        _mm_storeu_si128((__m128i*)(b.temp + i), T);
+        _mm_storeu_si128((__m128i*)(b.humi + i), H);
+        _mm_storeu_si128((__m128i*)(b.checksum + i), C);
+        _mm_storel_epi64((__m128i*)(b.id + i), _mm_packus_epi16(id, id));
+        _mm_storel_epi64((__m128i*)(b.status + i), _mm_packus_epi16(st, st));
+        _mm_storel_epi64((__m128i*)(b.valid + i), _mm_and_si128(_mm_packs_epi16(ok, ok), one));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+size_t decodeAvx2(const char* src, size_t n, FrameBatch& b)
+{
+    const __m256i shuffle = _mm256_setr_epi8(FRAME_SHUFFLE, FRAME_SHUFFLE);
+    const __m256i lowByte = _mm256_set1_epi16(0x00ff);
+    const __m128i one = _mm_set1_epi8(1);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        // 低半装第 0~7 帧，高半装第 8~15 帧
+        const char* p = src + i * FRAME_WIRE_SIZE + 2;
+        __m256i r[4];
+        for (int k = 0; k < 4; ++k) {
+            __m256i pair = _mm256_inserti128_si256(_mm256_castsi128_si256(FRAME_PAIR(p, 2 * k)), FRAME_PAIR(p, 8 + 2 * k), 1);
+            r[k] = _mm256_shuffle_epi8(pair, shuffle);
+        }
+        __m256i T, H, C, IS;
+        FRAME_TRANSPOSE(_mm256, r, T, H, C, IS);
+
+        __m256i id = _mm256_and_si256(IS, lowByte);
+        __m256i st = _mm256_srli_epi16(IS, 8);
+        __m256i sum = _mm256_add_epi16(_mm256_add_epi16(T, H), _mm256_add_epi16(id, st));
+        __m256i ok = _mm256_cmpeq_epi16(sum, C);
+
+        _mm256_storeu_si256((__m256i*)(b.temp + i), T);
+        _mm256_storeu_si256((__m256i*)(b.humi + i), H);
+        _mm256_storeu_si256((__m256i*)(b.checksum + i), C);
+        // pack 也按 128 位分半，[id0-7 st0-7 | id8-15 st8-15] 换成 [id0-15 | st0-15]
+        __m256i bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(id, st), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm_storeu_si128((__m128i*)(b.id + i), _mm256_castsi256_si128(bytes));
+        _mm_storeu_si128((__m128i*)(b.status + i), _mm256_extracti128_si256(bytes, 1));
+        __m256i mask = _mm256_permute4x64_epi64(_mm256_packs_epi16(ok, ok), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm_storeu_si128((__m128i*)(b.valid + i), _mm_and_si128(_mm256_castsi256_si128(mask), one));
+    }
+    return i;
+}
+
+#endif
+
+struct Kernel
+{
+    DecodeKernel fn;//nullptr 表示全部走标量
+    const char* name;
+};
+
+Kernel selectKernel()
+{
+#ifdef FRAME_SIMD
+    // 一个二进制跑在所有网关上：按运行时的 CPU 特性选，编译时不加 -mavx2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return { decodeAvx2, "avx2" };
+    if (__builtin_cpu_supports("sse4.1")) return { decodeSse4, "sse4.1" };
+#endif
+    return { nullptr, "scalar" };
+}
+
+const Kernel kernel = selectKernel();
+
+}
+
+
+void FrameBatch::decode(const char* src, size_t n)
+{
+    count = n;
+    size_t done = kernel.fn ? kernel.fn(src, n, *this) : 0;
+    decodeScalar(src, done, n, *this);
+}
+
+const char* frameKernelName()
+{
+    return kernel.name;
+}
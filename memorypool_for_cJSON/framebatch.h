@@ -0,0 +1,28 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include "packet.h"
+
+#define FRAME_BATCH_MAX 256 // 一次解码的最多帧数，缓冲区里更多的帧分几批处理
+#define FRAME_WIRE_SIZE (sizeof(SensorRawPacket) + 2) // 线上一帧：2 字节大端长度头 + 载荷
+
+
+// 一批解码后的帧，按字段分开存放（结构数组）：
+// decode 把缓冲区里连续的完整帧一次拆成各字段的连续数组，同时转好字节序、算出校验结果，
+// 输出阶段再逐帧发布。每个 Protocol 一份，反复使用，不分配内存
+struct FrameBatch
+{
+    size_t count = 0;
+    uint8_t id[FRAME_BATCH_MAX];
+    uint16_t temp[FRAME_BATCH_MAX];
+    uint16_t humi[FRAME_BATCH_MAX];
+    uint8_t status[FRAME_BATCH_MAX];
+    uint16_t checksum[FRAME_BATCH_MAX];
+    uint8_t valid[FRAME_BATCH_MAX];//校验和是否正确，0 或 1
+
+    // src 指向 n 个首尾相接的帧（含长度头，长度头由调用者检查过），n 不超过 FRAME_BATCH_MAX
+    // x86 上按 CPU 特性在启动时选 AVX2 / SSE4.1 实现，一次处理 16 / 8 帧，凑不满一组的尾部和其他平台走标量
+    void decode(const char* src, size_t n);
+};
+
+const char* frameKernelName();//当前选用的解码实现，启动时打印
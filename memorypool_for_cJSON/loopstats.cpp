@@ -0,0 +1,126 @@
+#include "loopstats.h"
+
+#include <time.h>
+
+
+static const char* kindName[] = { "accept", "connection", "udp", "ring", "mqtt", "wakeup", "other" };
+
+uint64_t LoopStats::now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void LoopStats::beforeWait()
+{
+    uint64_t t = now();
+    busyNs += t - woke;
+    mark = t;
+}
+
+void LoopStats::afterWait(int n)
+{
+    uint64_t t = now();
+    idleNs += t - mark;
+    mark = woke = t;
+
+    ++wakeups;
+    if (n <= 0) {
+        ++batch[0];
+        return;
+    }
+    events += n;
+    // 1 -> 1，2~3 -> 2，4~7 -> 3 ...
+    int b = 64 - __builtin_clzll((uint64_t)n);
+    if (b >= STAT_BATCH_BUCKETS) b = STAT_BATCH_BUCKETS - 1;
+    ++batch[b];
+}
+
+void LoopStats::spun(bool hit)
+{
+    uint64_t t = now();
+    spinNs += t - mark;
+    mark = t;
+    ++spins;
+    if (hit) ++spinHits;
+}
+
+void LoopStats::callback(HandlerKind k)
+{
+    uint64_t t = now();
+    uint64_t d = t - mark;
+    mark = t;
+
+    ++calls[(int)k];
+    handlerNs[(int)k] += d;
+    if (d > maxCallbackNs) {
+        maxCallbackNs = d;
+        maxKind = k;
+    }
+}
+
+void LoopStats::timer()
+{
+    uint64_t t = now();
+    ++timerRuns;
+    timerNs += t - mark;
+    mark = t;
+}
+
+void LoopStats::command(uint64_t ns)
+{
+    ++commands;
+    commandNs += ns;
+    if (ns > commandMaxNs) commandMaxNs = ns;
+}
+
+void LoopStats::print(std::ostream& os, const char* name) const
+{
+    uint64_t total = idleNs + busyNs;
+    os << name << ": wakeups=" << wakeups << " events=" << events
+        << " busy=" << busyNs / 1000000 << "ms idle=" << idleNs / 1000000 << "ms"
+        << " load=" << (total ? busyNs * 100 / total : 0) << "%\n";
+    if (spins) {
+        // 空转时间与阻塞时间之比，以及空转期间就等到事件的比例
+        os << "  busy-poll: spin=" << spinNs / 1000000 << "ms spin/idle="
+            << (idleNs ? spinNs * 100 / idleNs : 0) << "% hits=" << spinHits << "/" << spins << "\n";
+    }
+
+    os << "  events/wait:";
+    for (int i = 0; i < STAT_BATCH_BUCKETS; ++i) {
+        if (!batch[i]) continue;
+        if (i <= 1) os << " " << i;
+        else if (i == STAT_BATCH_BUCKETS - 1) os << " >=" << (1u << (i - 1));
+        else os << " " << (1u << (i - 1)) << "-" << (1u << i) - 1;
+        os << ":" << batch[i];
+    }
+    os << "\n";
+
+    for (int k = 0; k < kinds; ++k) {
+        if (!calls[k]) continue;
+        os << "  " << kindName[k] << ": calls=" << calls[k]
+            << " total=" << handlerNs[k] / 1000 << "us avg=" << handlerNs[k] / calls[k] << "ns\n";
+    }
+    os << "  timer: runs=" << timerRuns << " total=" << timerNs / 1000 << "us\n";
+    if (egressPeak) {
+        os << "  egress: peak=" << egressPeak << " pauses=" << ingressPauses << "\n";
+    }
+    if (commands || commandDrops) {
+        os << "  commands: sent=" << commands << " dropped=" << commandDrops
+            << " avg=" << (commands ? commandNs / commands / 1000 : 0) << "us max=" << commandMaxNs / 1000 << "us\n";
+    }
+    if (rateDrops || rateDefers) {
+        os << "  ratelimit: dropped=" << rateDrops << " deferred=" << rateDefers << "\n";
+    }
+    if (protoResyncs || protoChecksum || protoDatagrams) {
+        os << "  protocol: resyncs=" << protoResyncs << " skipped=" << protoSkipped
+            << " checksum=" << protoChecksum << " bad-datagrams=" << protoDatagrams << "\n";
+    }
+    if (ringRecords) {
+        uint64_t wakes = calls[(int)HandlerKind::Ring];
+        os << "  ring: records=" << ringRecords << " per-wakeup=" << (wakes ? ringRecords / wakes : 0) << "\n";
+    }
+    os << "  rxbuf: lent=" << rxLent << " pooled=" << rxPooled << "\n";
+    os << "  longest callback: " << maxCallbackNs / 1000 << "us (" << kindName[(int)maxKind] << ")\n";
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+
+#define STAT_BATCH_BUCKETS 12 // 每次等待返回事件数的直方图：0, 1, 2~3, 4~7, ... , >=1024
+
+// 按处理器类型分别统计耗时
+enum class HandlerKind : char { Accept, Connection, Udp, Ring, Mqtt, Wakeup, Other, Count };
+
+
+// 事件循环统计：唤醒次数、每次唤醒的事件数、空闲/忙碌时间、各类处理器耗时、定时器耗时、最长回调
+// 只在所属 Reactor 线程内写，不加锁也不用原子变量；其他线程通过 runInLoop 取一份快照
+// 用 CLOCK_MONOTONIC 打点，相邻两次打点首尾相接，每个回调只多一次取时
+struct LoopStats
+{
+    static constexpr int kinds = (int)HandlerKind::Count;
+
+    uint64_t wakeups = 0;
+    uint64_t events = 0;
+    uint64_t batch[STAT_BATCH_BUCKETS] = {};
+    uint64_t idleNs = 0;//阻塞在 epoll_wait / io_uring_wait 里的时间
+    uint64_t spinNs = 0;//忙轮询模式下阻塞之前空转的时间
+    uint64_t spins = 0;
+    uint64_t spinHits = 0;//空转期间等到了事件、没有进入阻塞的次数
+    uint64_t busyNs = 0;//其余时间
+    uint64_t calls[kinds] = {};
+    uint64_t handlerNs[kinds] = {};
+    uint64_t timerRuns = 0;
+    uint64_t timerNs = 0;
+    uint64_t maxCallbackNs = 0;
+    HandlerKind maxKind = HandlerKind::Other;
+    uint64_t egressPeak = 0;//MQTT 出口队列的最大积压条数
+    uint64_t ingressPauses = 0;//因出口积压停止读取的次数
+    uint64_t rxLent = 0;//取快照时借出的接收缓冲区数
+    uint64_t rxPooled = 0;//取快照时池里缓存的空闲块数
+    uint64_t commands = 0;//写进 socket 的下行命令数
+    uint64_t commandNs = 0;//从收到命令到写进 socket 的累计耗时
+    uint64_t commandMaxNs = 0;
+    uint64_t commandDrops = 0;//设备不在线、载荷过长等原因丢弃的命令数
+    uint64_t rateDrops = 0;//设备超速丢弃的帧数
+    uint64_t rateDefers = 0;//连接超速被推迟读取的次数
+    uint64_t protoResyncs = 0;//以下四项是 Protocol 的累计错误数，取快照时填入
+    uint64_t protoSkipped = 0;
+    uint64_t protoChecksum = 0;
+    uint64_t protoDatagrams = 0;
+    uint64_t ringRecords = 0;//从共享内存环取出的记录数，和 ring 回调次数之比就是每次唤醒取到的条数
+
+    uint64_t mark = 0;//上一次打点
+    uint64_t woke = 0;//上一次等待返回的时刻
+
+    void start() { mark = woke = now(); }//进入事件循环时调用
+    void beforeWait();
+    void afterWait(int n);
+    void spun(bool hit);//忙轮询结束，hit 表示空转期间等到了事件
+    void callback(HandlerKind k);//一次回调结束，自上次打点以来的时间都记到 k 上
+    void timer();//expireTimer 结束
+    void command(uint64_t ns);//一条下行命令写进 socket，ns 为从收到到写出的耗时
+
+    void print(std::ostream& os, const char* name) const;
+
+    static uint64_t now();
+};
@@ -1,10 +1,34 @@
 ﻿#include "reactor.h"
+#include "reactorpool.h"
+#include "uringreactor.h"
 #include "memorypool.h"
+#include "framebatch.h"
 #include <iostream>
+#include <thread>
+#include <csignal>
+#include <pthread.h>
+#include <cstring>
+
+#define COMMAND_TOPIC "sensor/cmd/" // 下行命令主题：sensor/cmd/<deviceId>，载荷原样转发给设备
 
 
 void on_message(struct mosquitto* mosq, void* userdata, const struct mosquitto_message* msg)
 {
+    // 下行命令：按主题里的 deviceId 路由到设备所在的连接，userdata 是订阅这个客户端的 Reactor
+    size_t prefix = strlen(COMMAND_TOPIC);
+    if (strncmp(msg->topic, COMMAND_TOPIC, prefix) == 0) {
+        char* end;
+        long id = strtol(msg->topic + prefix, &end, 10);
+        if (end == msg->topic + prefix || *end != '\0' || id < 0 || id >= DEVICE_MAX) {
+            fprintf(stderr, "Command topic %s: bad device id, dropped\n", msg->topic);
+            return;
+        }
+        const char* payload = msg->payload ? (const char*)msg->payload : "";
+        size_t len = msg->payloadlen > 0 ? (size_t)msg->payloadlen : 0;
+        static_cast<IReactor*>(userdata)->routeCommand((uint8_t)id, payload, len);
+        return;
+    }
+
     // 打印主题（topic 不会为 NULL，MQTT 协议保证）
     printf("Topic: %s\n", msg->topic);
 
@@ -28,49 +52,140 @@ void on_message(struct mosquitto* mosq, void* userdata, const struct mosquitto_m
     printf("------------------------\n");
 }
 
-int main() {
-    // 1. 初始化 MQTT
-    mosquitto_lib_init();
-    // 將 reactor 指針預留，以便回調函數使用
-    struct mosquitto* mosq = mosquitto_new("gateway_client", true, nullptr);
+// 0 号客户端每次连上 broker（包括断线重连）都调用：clean session 下 broker 不保留订阅，
+// 只在启动时订阅一次的话，重连之后或者启动时 broker 还没起来，下行命令就再也收不到了
+void on_connect(struct mosquitto* mosq, void* userdata, int rc)
+{
+    if (rc != 0) {
+        fprintf(stderr, "MQTT connect refused: %s\n", mosquitto_connack_string(rc));
+        return;
+    }
+    const char* topics[] = { "sensor", COMMAND_TOPIC "+" };
+    for (const char* topic : topics) {
+        int err = mosquitto_subscribe(mosq, NULL, topic, 0);
+        if (err != MOSQ_ERR_SUCCESS) {
+            fprintf(stderr, "MQTT subscribe %s failed: %s\n", topic, mosquitto_strerror(err));
+        }
+    }
+
+    // 回调里排进队列的报文 libmosquitto 不会当场写出，和 publish 一样要让 Reactor 关注写事件
+    int fd = mosquitto_socket(mosq);
+    if (fd != -1 && mosquitto_want_write(mosq)) {
+        static_cast<IReactor*>(userdata)->update(fd, EPOLLIN | EPOLLOUT);
+    }
+}
+
+// 为第 index 个 Reactor 线程创建 MQTT 客户端，mosquitto 实例不是线程安全的，每个线程各用一个
+static struct mosquitto* createMqttClient(int index)
+{
+    char clientId[32];
+    snprintf(clientId, sizeof(clientId), "gateway_client_%d", index);
+    struct mosquitto* mosq = mosquitto_new(clientId, true, nullptr);
 
     mosquitto_message_callback_set(mosq, on_message);
 
-    // 2. 異步連接 (這不會阻塞，但會初始化內部數據結構)
-    mosquitto_connect_async(mosq, "127.0.0.1", 1883, 60);
-    mosquitto_subscribe(mosq, NULL, "sensor", 0);
+    // 只讓一個客戶端訂閱，避免同一條消息被每個線程重複處理；訂閱放在連接回調裡，每次連上都重新訂閱
+    if (index == 0) {
+        mosquitto_connect_callback_set(mosq, on_connect);
+    }
 
-    // 3. 初始化本地 TCP 監聽
-    int sockfd = socket(AF_INET, SOCK_STREAM, 0);
-    int opt = 1;
-    setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    // 異步連接 (這不會阻塞，但會初始化內部數據結構)
+    mosquitto_connect_async(mosq, "127.0.0.1", 1883, 60);
+    return mosq;
+}
 
-    struct sockaddr_in serveraddr {};
-    serveraddr.sin_family = AF_INET;
-    serveraddr.sin_port = htons(2048);
-    serveraddr.sin_addr.s_addr = htonl(INADDR_ANY);
+int main(int argc, char* argv[]) {
+    // 1. 初始化 MQTT
+    mosquitto_lib_init();
 
-    if (bind(sockfd, (struct sockaddr*)&serveraddr, sizeof(serveraddr)) < 0) {
-        perror("Bind failed");
-        return -1;
+    // 2. 用法：edgelink-gateway [-t 線程數] [-m reuseport|mainsub] [-b ll|rr] [-e epoll|uring] [-p 微秒] [-c 起始核] [-s] [-u UDP端口] [-r 設備幀率[,連接幀率]] [-l 路徑] [-q 路徑] [-g 路徑]
+    // 線程數默認每個核一個；mainsub 模式下另有一個 accept 線程，ll 為最少連接優先，rr 為輪詢
+    // -p 忙輪詢：阻塞等待前先空轉指定微秒數，用 CPU 換喚醒延遲；-c 把第 i 個 Reactor 綁到第 起始核+i 號核上
+    // -s 連接改用協程會話（SensorSession）處理；-u 同時在指定端口收 UDP 上報，每個數據報一幀
+    // -r 限速（幀/秒，0 不限，突發量為一秒）：設備超速的幀丟棄，連接超速時暫停讀取
+    // -l / -q 同時在 AF_UNIX 路徑上監聽（SOCK_STREAM / SOCK_SEQPACKET），供本機採集進程使用，幀格式與 TCP 相同
+    // -g 共享內存環的控制套接字：本機高頻生產者連上來領取環（memfd + eventfd），之後直接寫共享內存，見 shmring.h
+    int threads = (int)std::thread::hardware_concurrency();
+    PoolMode mode = PoolMode::ReusePort;
+    Balance balance = Balance::LeastLoaded;
+    Backend backend = Backend::Epoll;
+    int busyPoll = 0;
+    int firstCpu = -1;
+    bool coSessions = false;
+    uint16_t udpPort = 0;
+    RateLimit limit;
+    std::vector<std::string> streamPaths, packetPaths, ringPaths;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "t:m:b:e:p:c:su:r:l:q:g:")) != -1) {
+        switch (opt) {
+        case 't': threads = atoi(optarg); break;
+        case 'm': mode = strcmp(optarg, "mainsub") == 0 ? PoolMode::MainSub : PoolMode::ReusePort; break;
+        case 'b': balance = strcmp(optarg, "rr") == 0 ? Balance::RoundRobin : Balance::LeastLoaded; break;
+        case 'e': backend = strcmp(optarg, "uring") == 0 ? Backend::Uring : Backend::Epoll; break;
+        case 'p': busyPoll = atoi(optarg); break;
+        case 'c': firstCpu = atoi(optarg); break;
+        case 's': coSessions = true; break;
+        case 'u': udpPort = (uint16_t)atoi(optarg); break;
+        case 'r': sscanf(optarg, "%u,%u", &limit.deviceRate, &limit.connRate); break;
+        case 'l': streamPaths.push_back(optarg); break;
+        case 'q': packetPaths.push_back(optarg); break;
+        case 'g': ringPaths.push_back(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [-t threads] [-m reuseport|mainsub] [-b ll|rr] [-e epoll|uring] [-p busy-poll-us] [-c first-cpu] [-s] [-u udp-port] [-r device-fps[,conn-fps]] [-l unix-stream-path] [-q unix-seqpacket-path] [-g ring-control-path]\n", argv[0]);
+            return -1;
+        }
     }
-    listen(sockfd, 128);
-    set_nonblocking(sockfd);
-   
-
-    // 獲取 MQTT 的 Socket 並註冊到 Epoll
-    int mosqfd = mosquitto_socket(mosq);
-    Reactor reactor(sockfd, mosq);
-    if (mosqfd != -1) {
-        // 將 mosq 實例傳入，以便 Handler 內部調用
-        reactor.mqttRegister(mosqfd, EPOLLIN, nullptr, mosq);
+    if (threads <= 0) threads = 1;
+
+    // 內核不支持緩衝區環（5.19 之前）時退回 epoll
+    if (backend == Backend::Uring && !UringReactor::supported()) {
+        std::cerr << "io_uring backend not supported by this kernel, falling back to epoll" << std::endl;
+        backend = Backend::Epoll;
     }
 
-    std::cout << "Gateway is running... Listening on port 2048" << std::endl;
+    // 3. reuseport：每個線程一個 SO_REUSEPORT 監聽套接字，由內核分發新連接
+    //    mainsub：主 Reactor 統一 accept，再把連接移交給工作線程
+    ReactorPool pool(threads, 2048, createMqttClient, mode, balance, backend);
+    pool.setBusyPoll(busyPoll);
+    pool.setCpuAffinity(firstCpu);
+    pool.setCoSessions(coSessions);
+    pool.setUdpPort(udpPort);
+    limit.deviceBurst = std::max(limit.deviceRate, 1u);
+    limit.connBurst = std::max(limit.connRate, 1u);
+    pool.setRateLimit(limit);
+    for (const std::string& path : streamPaths) pool.addLocalPath(path, SOCK_STREAM);
+    for (const std::string& path : packetPaths) pool.addLocalPath(path, SOCK_SEQPACKET);
+    for (const std::string& path : ringPaths) pool.addRingPath(path);
+
+    // SIGUSR1 打印各 Reactor 的事件循環統計；先在主線程屏蔽，工作線程繼承屏蔽字，信號只由下面的 sigwait 接收
+    sigset_t sigs;
+    sigemptyset(&sigs);
+    sigaddset(&sigs, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &sigs, nullptr);
+
+    if (!pool.start()) {
+        return -1;
+    }
 
-    // 5. 進入統一的事件循環
-    // 注意：確保你的 mqttLoop 內部調用了 expireTimer
-    reactor.mqttLoop();
+    std::cout << "Gateway is running... Listening on port 2048 with " << threads << " reactor(s)"
+        << (mode == PoolMode::MainSub ? " behind an acceptor" : "")
+        << (backend == Backend::Uring ? " (io_uring)" : " (epoll)")
+        << (busyPoll > 0 ? ", busy-poll " + std::to_string(busyPoll) + "us" : std::string())
+        << (coSessions ? ", coroutine sessions" : "")
+        << (udpPort ? ", udp port " + std::to_string(udpPort) : std::string())
+        << (limit.deviceRate || limit.connRate ? ", rate limit " + std::to_string(limit.deviceRate) + "/" + std::to_string(limit.connRate) + " fps" : std::string());
+    for (const std::string& path : streamPaths) std::cout << ", unix " << path;
+    for (const std::string& path : packetPaths) std::cout << ", unix seqpacket " << path;
+    for (const std::string& path : ringPaths) std::cout << ", shm ring " << path;
+    std::cout << ", " << frameKernelName() << " frame decode" << std::endl;
+
+    // 4. 每個線程各自進入統一的事件循環（mqttLoop 內部調用了 expireTimer），主線程只負責響應統計請求
+    int sig;
+    while (sigwait(&sigs, &sig) == 0) {
+        pool.dumpStats(std::cerr);
+    }
+    pool.join();
 
     return 0;
 }
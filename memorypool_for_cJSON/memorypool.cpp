@@ -2,7 +2,7 @@
 #include <stdlib.h>
 
 
-MemoryPool* globalMemoryPool = nullptr;
+thread_local MemoryPool* globalMemoryPool = nullptr;
 extern "C"
 {
     void* myMalloc(size_t size)
@@ -59,7 +59,8 @@ private:
 };
 
 
-extern MemoryPool* globalMemoryPool;
+// 每个线程一个内存池前端：Reactor 线程之间互不争用，cJSON 对象的申请和释放都在同一线程内完成
+extern thread_local MemoryPool* globalMemoryPool;
 #ifdef __cplusplus
 extern "C" {
 #endif
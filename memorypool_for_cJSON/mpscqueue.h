@@ -0,0 +1,61 @@
+#pragma once
+#include <atomic>
+#include <utility>
+
+// 无锁多生产者单消费者队列（Vyukov 链表队列）
+// push 可以在任意线程调用，pop/empty 只能在唯一的消费者线程（Reactor 所在线程）调用
+template <typename T>
+class MpscQueue
+{
+public:
+    MpscQueue()
+    {
+        Node* stub = new Node();
+        head.store(stub, std::memory_order_relaxed);
+        tail = stub;
+    }
+
+    ~MpscQueue()
+    {
+        T value;
+        while (pop(value)) {}
+        delete tail;
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    void push(T value)
+    {
+        Node* node = new Node();
+        node->value = std::move(value);
+        // 先抢占队头，再把前一个节点链到新节点上；两步之间消费者最多看到队列“暂时变短”
+        Node* prev = head.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    bool pop(T& value)
+    {
+        Node* next = tail->next.load(std::memory_order_acquire);
+        if (!next) return false;
+        value = std::move(next->value);
+        delete tail;
+        tail = next;//next 成为新的哨兵节点
+        return true;
+    }
+
+    bool empty()
+    {
+        return tail->next.load(std::memory_order_acquire) == nullptr;
+    }
+
+private:
+    struct Node
+    {
+        std::atomic<Node*> next{ nullptr };
+        T value{};
+    };
+
+    std::atomic<Node*> head;//生产者端
+    Node* tail;//消费者端，始终指向哨兵节点
+};
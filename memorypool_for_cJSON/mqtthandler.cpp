@@ -1,5 +1,5 @@
 #include "mqtthandler.h"
-#include "reactor.h"      // ȡ Reactor 塢epoll  timewheel
+#include "reactor.h"      // 获取 Reactor 完整定义、epoll 常量和 timewheel
 #include <cstdio>
 #include <cerrno>
 #include <unistd.h>
@@ -8,10 +8,10 @@
 #include <sys/epoll.h>
 #include <cstring>
 
-// MqttHandler Աʵ
+// MqttHandler 成员实现
 void MqttHandler::handleRead(int fd)
 {
-    // ETģʽѭȡֱݶ
+    // ET模式下循环读取，直到数据读尽
     while (true)
     {
         int rc = mosquitto_loop_read(mosq, 1);
@@ -20,56 +20,42 @@ void MqttHandler::handleRead(int fd)
         {
             if (rc == MOSQ_ERR_CONN_LOST || rc == MOSQ_ERR_NO_CONN) {
                 std::printf("MQTT Connection lost. Triggering reconnect logic...\n");
-
-                // 1. ȴ Reactor Ƴɵ fd
-                reactor->remove(fd);
-                close(fd);
-
-                // 2.  (libmosquitto Զ Socket)
-                if (mosquitto_reconnect_async(mosq) == MOSQ_ERR_SUCCESS) {
-                    int new_fd = mosquitto_socket(mosq);
-                    // 3.  fd ע ReactorReactor Ķ˴ɼ
-                    reactor->mqttRegister(new_fd, EPOLLOUT | EPOLLIN, shared_from_this(), nullptr);
-                }
+                reconnect(fd);
                 break;
             }
             else {
-                // 
+                // 处理其他致命错误
                 std::printf("Fatal MQTT error: %s\n", mosquitto_strerror(rc));
                 reactor->remove(fd);
-                // mosquitto_destroy ȷʹøö
+                // mosquitto_destroy 建议放在析构函数里，或者确保不再使用该对象
                 break;
             }
         }
         char dummy;
         ssize_t s = recv(fd, &dummy, 1, MSG_PEEK | MSG_DONTWAIT);
-        if (s <= 0) {
-            // s == 0 ʾԶ˹رգs == -1 Ϊ EAGAIN ʾ
+        if (s < 0) {
+            // s == -1 且为 EAGAIN 表示读尽
             break;
         }
+        // s == 0 表示对端关闭：FIN 可能和最后一个报文一起到达，之后不会再有边沿，
+        // 再调一次 loop_read 让 libmosquitto 报告断线，走上面的重连
     }
 }
 
 void MqttHandler::handleWrite(int fd)
 {
-    while (mosquitto_want_write(mosq)) // Ϣзǿ
+    while (mosquitto_want_write(mosq)) // 消息队列非空
     {
-        int rc = mosquitto_loop_write(mosq, 1); // ÿηһ
+        int rc = mosquitto_loop_write(mosq, 1); // 每次发一包
 
         if (rc != MOSQ_ERR_SUCCESS)
         {
             if (rc == MOSQ_ERR_CONN_LOST || rc == MOSQ_ERR_NO_CONN)
             {
-                reactor->remove(fd);
-                close(fd);
-                if (mosquitto_reconnect_async(mosq) == MOSQ_ERR_SUCCESS)
-                {
-                    int new_fd = mosquitto_socket(mosq);
-                    reactor->mqttRegister(new_fd, EPOLLIN | EPOLLOUT, shared_from_this(), nullptr);
-                }
+                reconnect(fd);
                 return;
             }
-            else if (rc == MOSQ_ERR_ERRNO && (errno == EAGAIN || errno == EWOULDBLOCK)) // 
+            else if (rc == MOSQ_ERR_ERRNO && (errno == EAGAIN || errno == EWOULDBLOCK)) // 缓冲区已满
             {
                 reactor->update(fd, EPOLLIN | EPOLLOUT);
                 return;
@@ -82,27 +68,63 @@ void MqttHandler::handleWrite(int fd)
         }
     }
 
-    // Ϣѿ
+    // 消息队已空
     reactor->update(fd, EPOLLIN);
 }
 
 void MqttHandler::handleMisc()
 {
-    if (!mosq) return;
+    if (!mosq || retryTimer) return;//等待重连期间没有连接可维护
 
-    // ڲᴦķͺ첽״̬ά
+    // 内部会处理心跳包的发送和异步重连的状态维护
     int rc = mosquitto_loop_misc(mosq);
 
-    //  misc ӳûˣҲﴥ reconnect
+    // 如果 misc 发现连接彻底没救了，也可以在这里触发 reconnect
     if (rc == MOSQ_ERR_NO_CONN) {
-        mosquitto_reconnect_async(mosq);
+        reconnect(sockFd);
+    }
+}
+
+void MqttHandler::reconnect(int oldFd)
+{
+    // 先从 Reactor 移除旧的 fd；之后到重新注册之前 handler 表里没有自己，由 retained 持有
+    retained = shared_from_this();
+    if (oldFd != -1) {
+        reactor->remove(oldFd);
+        close(oldFd);
+    }
+    sockFd = -1;
+    reactor->resetEgress();
+
+    // 隔一段时间再连：broker 不在时每次都是立即被拒，当场重连会让事件循环空转
+    if (!retryTimer) {
+        retryTimer = addNewTimer(reactor->getWheel(), onRetryTimer, MQTT_RETRY_MS, this);
+    }
+}
+
+void MqttHandler::onRetryTimer(void* arg)
+{
+    auto self = static_cast<MqttHandler*>(arg);
+    self->retryTimer = nullptr;//节点由时间轮在回调返回后释放
+    std::shared_ptr<MqttHandler> keep = std::move(self->retained);
+
+    // libmosquitto 会自动创建新 Socket；连上后由连接回调重新订阅
+    if (mosquitto_reconnect_async(self->mosq) == MOSQ_ERR_SUCCESS && mosquitto_socket(self->mosq) != -1) {
+        // 将新 fd 重新注册回 Reactor，CONNECT 报文可能还在队列里，同时关注写事件
+        self->reactor->mqttRegister(mosquitto_socket(self->mosq), EPOLLOUT | EPOLLIN, keep, nullptr);
+    }
+    else {
+        self->reconnect(-1);
     }
 }
 
 MqttHandler::~MqttHandler()
 {
     if (timer) {
-        cancelTimer(timer); //  active Ϊ falseֹصҰָ
+        cancelTimer(timer); // 将 active 设为 false，防止回调野指针
+    }
+    if (retryTimer) {
+        cancelTimer(retryTimer);
     }
     if (mosq) {
         mosquitto_destroy(mosq);
@@ -115,32 +137,16 @@ void MqttHandler::setMosq(mosquitto* m)
 }
 void Reactor::mqttLoop()
 {
+    stats.start();
     while (1) {
-        int nfds = epoll_wait(efd, events, MAX_EVENTS, 10);
-        for (int i = 0; i < nfds; ++i) {
-            int fd = events[i].data.fd;
-            uint32_t revents = events[i].events;
-
-            // 1.  handler Ƿڣֹ֮ǰѭѾɾ
-            if (handler.find(fd) == handler.end()) continue;
-
-            // 2. 
-            if (revents & (EPOLLIN | EPOLLPRI | EPOLLRDHUP)) {
-                handler[fd]->handleRead(fd);
-            }
-
-            // 3. ٴμ飬handleRead ܴ remove
-            if (handler.find(fd) != handler.end() && (revents & EPOLLOUT)) {
-                handler[fd]->handleWrite(fd);
-            }
-
-            // 4. 
-            if (handler.find(fd) != handler.end() && (revents & (EPOLLERR | EPOLLHUP))) {
-                close(fd);
-                remove(fd);
-            }
-        }
+        flushUpdates();
+        stats.beforeWait();
+        int nfds = waitEvents(hasReady() ? 0 : 10);
+        stats.afterWait(nfds);
+        doReadyList();
+        handleEvents(nfds);
 
         expireTimer(getWheel());
+        stats.timer();
     }
 }
\ No newline at end of file
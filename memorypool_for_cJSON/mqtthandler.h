@@ -2,7 +2,9 @@
 #include "eventhandler.h"
 #include <memory>
 
-// ǰⲻҪͷļµѭ
+#define MQTT_RETRY_MS 1000 // 和 broker 断开后隔多久重连
+
+// 前向声明，避免不必要的头文件包含导致的循环依赖
 struct TimeWheelNode;
 
 class MqttHandler : public EventHandler, public std::enable_shared_from_this<MqttHandler>
@@ -10,14 +12,22 @@ class MqttHandler : public EventHandler, public std::enable_shared_from_this<Mqt
 private:
     TimeWheelNode* timer;
     struct mosquitto* mosq;
+    int sockFd = -1;//当前注册在 Reactor 里的 fd
+    TimeWheelNode* retryTimer = nullptr;//非空表示等待重连
+    std::shared_ptr<MqttHandler> retained;//等待重连期间不在 handler 表里，由自己持有
+
+    static void onRetryTimer(void* arg);
 public:
     void handleRead(int fd);
     void handleWrite(int fd);
+    HandlerKind kind() const override { return HandlerKind::Mqtt; }
     void handleMisc();
-    explicit MqttHandler(Reactor* r, Protocol* p) : EventHandler(r, p), timer(nullptr), mosq(nullptr) {}
+    void reconnect(int oldFd);//注销并关闭旧 fd，定时重连；读、写、心跳三处发现断线都走这里
+    explicit MqttHandler(IReactor* r, Protocol* p) : EventHandler(r, p), timer(nullptr), mosq(nullptr) {}
     ~MqttHandler();
     void setMosq(struct mosquitto* m);
 
+    void setFd(int fd) { sockFd = fd; }
     void setTimer(TimeWheelNode* t) { timer = t; }
     TimeWheelNode* getTimer() { return timer; }
 };
@@ -0,0 +1,141 @@
+#include "outputchain.h"
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <sys/socket.h>
+
+
+namespace {
+
+// 每个线程一个空闲块链表，线程退出时释放
+struct ChunkCache
+{
+    OutputChunk* list = nullptr;
+    size_t count = 0;
+
+    ~ChunkCache()
+    {
+        while (list) {
+            OutputChunk* next = list->next;
+            free(list);
+            list = next;
+        }
+    }
+};
+
+thread_local ChunkCache chunkCache;
+
+OutputChunk* getChunk()
+{
+    OutputChunk* c = chunkCache.list;
+    if (c) {
+        chunkCache.list = c->next;
+        --chunkCache.count;
+    }
+    else {
+        c = static_cast<OutputChunk*>(malloc(sizeof(OutputChunk)));
+        if (!c) return nullptr;
+    }
+    c->next = nullptr;
+    c->begin = c->end = 0;
+    return c;
+}
+
+void putChunk(OutputChunk* c)
+{
+    if (chunkCache.count >= OUTPUT_FREE_MAX) {
+        free(c);
+        return;
+    }
+    c->next = chunkCache.list;
+    chunkCache.list = c;
+    ++chunkCache.count;
+}
+
+}
+
+
+void OutputChain::append(const char* src, size_t n)
+{
+    while (n > 0) {
+        if (!tail || tail->end == OUTPUT_CHUNK_SIZE) {
+            OutputChunk* c = getChunk();
+            if (!c) {
+                perror("OutputChain malloc");
+                return;
+            }
+            if (tail) tail->next = c;
+            else head = c;
+            tail = c;
+        }
+        size_t room = std::min<size_t>(n, OUTPUT_CHUNK_SIZE - tail->end);
+        memcpy(tail->data + tail->end, src, room);
+        tail->end += room;
+        bytes += room;
+        src += room;
+        n -= room;
+    }
+}
+
+void OutputChain::consume(size_t n)
+{
+    n = std::min(n, bytes);
+    bytes -= n;
+    while (n > 0) {
+        size_t avail = head->end - head->begin;
+        if (n < avail) {
+            head->begin += n;
+            return;
+        }
+        n -= avail;
+        OutputChunk* next = head->next;
+        putChunk(head);
+        head = next;
+    }
+    if (!head) tail = nullptr;
+}
+
+void OutputChain::clear()
+{
+    while (head) {
+        OutputChunk* next = head->next;
+        putChunk(head);
+        head = next;
+    }
+    tail = nullptr;
+    bytes = 0;
+}
+
+void OutputChain::swap(OutputChain& other) noexcept
+{
+    std::swap(head, other.head);
+    std::swap(tail, other.tail);
+    std::swap(bytes, other.bytes);
+}
+
+int OutputChain::peek(struct iovec* iov, int max) const
+{
+    int n = 0;
+    for (OutputChunk* c = head; c && n < max; c = c->next) {
+        if (c->begin == c->end) continue;
+        iov[n].iov_base = c->data + c->begin;
+        iov[n].iov_len = c->end - c->begin;
+        ++n;
+    }
+    return n;
+}
+
+ssize_t OutputChain::sendTo(int fd)
+{
+    struct iovec iov[OUTPUT_IOV_MAX];
+    struct msghdr msg {};
+    msg.msg_iov = iov;
+    msg.msg_iovlen = peek(iov, OUTPUT_IOV_MAX);
+    if (msg.msg_iovlen == 0) return 0;
+
+    // MSG_NOSIGNAL：对端已关闭时返回 EPIPE 而不是让整个进程收到 SIGPIPE
+    ssize_t n = sendmsg(fd, &msg, MSG_NOSIGNAL);
+    if (n > 0) consume(n);
+    return n;
+}
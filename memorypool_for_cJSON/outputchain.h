@@ -0,0 +1,51 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#define OUTPUT_CHUNK_SIZE 4096 // 每块的数据容量
+#define OUTPUT_IOV_MAX 16 // 一次 sendmsg 最多交给内核的块数
+#define OUTPUT_FREE_MAX 256 // 每个线程缓存的空闲块上限，超出的还给系统
+
+
+struct OutputChunk
+{
+    OutputChunk* next;
+    uint32_t begin;//[begin, end) 是还没发出去的数据
+    uint32_t end;
+    char data[OUTPUT_CHUNK_SIZE];
+};
+
+// 发送缓冲区链：追加写进尾块，尾块满了再挂一块；发送时把头部若干块拼成 iovec 一次交给内核
+// 部分发送只推进头块的 begin，发完的块还回本线程的空闲链表，不搬数据，也没有整体扩容和拷贝
+// 块只在本线程内申请和回收，和内存池前端一样不需要加锁
+class OutputChain
+{
+public:
+    OutputChain() = default;
+    ~OutputChain() { clear(); }
+    OutputChain(const OutputChain&) = delete;
+    OutputChain& operator=(const OutputChain&) = delete;
+    OutputChain(OutputChain&& other) noexcept { swap(other); }
+    OutputChain& operator=(OutputChain&& other) noexcept { clear(); swap(other); return *this; }
+
+    size_t size() const { return bytes; }//待发送的字节数
+    bool empty() const { return bytes == 0; }
+
+    void append(const char* src, size_t n);
+    void consume(size_t n);//丢掉开头 n 个已经发出去的字节
+    void clear();
+    void swap(OutputChain& other) noexcept;
+
+    // 把头部最多 max 块待发数据填进 iov，返回用掉的项数；iov 指向块内存，consume 之前一直有效
+    int peek(struct iovec* iov, int max) const;
+
+    // 一次 sendmsg 发出头部最多 OUTPUT_IOV_MAX 块并消费掉发出去的部分，返回值同 sendmsg
+    ssize_t sendTo(int fd);
+
+private:
+    OutputChunk* head = nullptr;
+    OutputChunk* tail = nullptr;
+    size_t bytes = 0;
+};
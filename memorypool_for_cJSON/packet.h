@@ -1,13 +1,94 @@
 #pragma once
 #include <cstdint>
+#include "schema.h"
 
 
 #pragma pack(push, 1)
 struct SensorRawPacket {
-    uint8_t  deviceId;   // 1 ֽ
-    uint16_t rawTemp;    // 2 ֽ ()
-    uint16_t rawHumi;    // 2 ֽ ()
-    uint8_t  statusCode; // 1 ֽ
-    uint16_t checksum;   // 2 ֽ ()
+    uint8_t  deviceId;   // 1 字节
+    uint16_t rawTemp;    // 2 字节 (大端)
+    uint16_t rawHumi;    // 2 字节 (大端)
+    uint8_t  statusCode; // 1 字节
+    uint16_t checksum;   // 2 字节 (大端)
+};
+#pragma pack(pop)
+
+// 定长帧载荷的描述：解码、校验、编码都由字段表生成（见 schema.h）；
+// SensorRawPacket 是同一布局的内存视图，共享内存环按它存放记录，生产者可以直接填写
+struct SensorReading {
+    uint8_t  deviceId;
+    uint16_t temp;
+    uint16_t humi;
+    uint8_t  status;
+    uint16_t checksum;
+};
+
+struct SensorRawSchema {
+    using DeviceId = Field<&SensorReading::deviceId, 0>;
+    using Temp = Field<&SensorReading::temp, 1, Endian::Big, 100>;
+    using Humi = Field<&SensorReading::humi, 3, Endian::Big, 100>;
+    using Status = Field<&SensorReading::status, 5>;
+    using Checksum = Field<&SensorReading::checksum, 6>;
+    using Check = Sum16<Checksum, &SensorReading::deviceId, &SensorReading::temp, &SensorReading::humi, &SensorReading::status>;
+    using Packet = Layout<SensorReading, 8, Check, DeviceId, Temp, Humi, Status, Checksum>;
+};
+static_assert(sizeof(SensorRawPacket) == SensorRawSchema::Packet::size, "SensorRawPacket must match its schema");
+
+
+
+// 帧格式版本：连接建立时默认 1，只认上面的定长帧；设备发 LinkHello 报出自己支持的最高版本，
+// 网关回一个 kind 为 LINK_ACK 的 LinkHello 给出双方都支持的版本，之后才可以发多样本帧。
+// 老网关把握手当作错位数据跳过、不回确认，设备等不到确认就继续用定长帧
+#define FRAME_VERSION_FIXED 1
+#define FRAME_VERSION_MULTI 2
+#define FRAME_VERSION_MAX FRAME_VERSION_MULTI
+
+#define LINK_MAGIC0 'E'
+#define LINK_MAGIC1 'L'
+#define LINK_HELLO 'H'
+#define LINK_ACK 'A'
+
+#define FRAME_MULTI_TYPE 0xB2 // 多样本帧载荷的第一个字节
+#define FRAME_MULTI_MAX_SAMPLES 255
+
+
+// 握手：长度头 + 4 字节载荷，上行是 LINK_HELLO，下行确认是 LINK_ACK
+struct LinkHello {
+    uint8_t magic0;      // LINK_MAGIC0
+    uint8_t magic1;      // LINK_MAGIC1
+    uint8_t kind;        // LINK_HELLO / LINK_ACK
+    uint8_t version;     // 上行：设备支持的最高版本；下行：协商结果
+};
+
+struct LinkHelloSchema {
+    using Packet = Layout<LinkHello, 4, NoCheck,
+        Field<&LinkHello::magic0, 0>, Field<&LinkHello::magic1, 1>, Field<&LinkHello::kind, 2>, Field<&LinkHello::version, 3>>;
+};
+
+// 多样本帧（版本 2）：长度头 + 帧头 + count 个样本 + 2 字节 CRC，全部大端
+// 长度头 = 帧头 + count * 样本 + 2，和 count 对不上的当作错位
+// CRC-16/CCITT-FALSE（多项式 0x1021，初值 0xFFFF），覆盖长度头到最后一个样本；帧长可变，由 Protocol 整帧计算
+struct SensorMultiHeader {
+    uint8_t  type;       // FRAME_MULTI_TYPE
+    uint8_t  deviceId;
+    uint8_t  status;
+    uint8_t  count;      // 样本数，1 ~ FRAME_MULTI_MAX_SAMPLES
+    uint32_t baseTime;   // 设备时钟（毫秒），第一个样本的时刻 = baseTime + 第一个 delta
+};
+
+struct SensorSample {
+    uint16_t delta;      // 距上一个样本的毫秒数
+    uint16_t temp;
+    uint16_t humi;
+};
+
+struct SensorMultiSchema {
+    using Header = Layout<SensorMultiHeader, 8, NoCheck,
+        Field<&SensorMultiHeader::type, 0>, Field<&SensorMultiHeader::deviceId, 1>, Field<&SensorMultiHeader::status, 2>,
+        Field<&SensorMultiHeader::count, 3>, Field<&SensorMultiHeader::baseTime, 4>>;
+    using Temp = Field<&SensorSample::temp, 2, Endian::Big, 100>;
+    using Humi = Field<&SensorSample::humi, 4, Endian::Big, 100>;
+    using Sample = Layout<SensorSample, 6, NoCheck, Field<&SensorSample::delta, 0>, Temp, Humi>;
+
+    static constexpr size_t frameLen(size_t count) { return Header::size + count * Sample::size + 2; }//长度头的值
 };
-#pragma pack(pop)
\ No newline at end of file
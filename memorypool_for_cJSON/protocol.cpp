@@ -1,6 +1,8 @@
 #include "protocol.h"
+#include "reactor.h"
 #include <string.h>
 #include <memory>
+#include <algorithm>
 #include <netinet/in.h>
 #include "packet.h"
 #include <iostream>
@@ -8,79 +10,260 @@
 #include <mosquitto.h>
 
 
-void Protocol::frameParse()//ѻݽΪmqtt֡
+bool Protocol::frameParse(Buffer& recvBuffer, IReactor* reactor, int fd, TokenBucket* bucket, uint8_t& version)//把缓冲区数据解析为mqtt帧
 {
 
-	//ÿ֡Dispatcher
+	//解析出的每个完整帧发交给Dispatcher处理
 
+    const size_t frameLen = FRAME_WIRE_SIZE;
     while (true)
     {
-        // 1. У (Header 2 bytes + Payload 8 bytes)
-        if (recvBuffer.size() < 10) return;
-
-        uint16_t len;
-        memcpy(&len, recvBuffer.data(), 2);
-        len = ntohs(len);
-
-        // 2. Э³Լ
-        if (len != sizeof(SensorRawPacket)) {
-            std::cerr << "Protocol Error: Expected " << sizeof(SensorRawPacket)
-                << ", got " << len << ". Sliding buffer..." << std::endl;
-            recvBuffer.erase(0, 1); // ֽڻѰһͬͷֹڴλӱ
-            continue;
+        // 0. 出口积压到高水位：剩下的留在缓冲区，恢复时接着解析
+        if (reactor->isIngressPaused()) return true;
+
+        // 1. 解码：数出开头连续的完整帧（长度头正确），整段交给 batch 一次拆字段、转字节序、校验，不消费
+        const char* data = recvBuffer.data();
+        size_t size = recvBuffer.size();
+        size_t n = 0;
+        while (n < FRAME_BATCH_MAX && size - n * frameLen >= frameLen)
+        {
+            uint16_t len;
+            memcpy(&len, data + n * frameLen, 2);
+            if (ntohs(len) != sizeof(SensorRawPacket)) break;//错位，先把前面的帧处理完
+            ++n;
         }
+        batch.decode(data, n);
 
-        if (recvBuffer.size() < (len + 2)) return; // ȴݰȫ
-
-        // 3. ָתֽ
-        SensorRawPacket* raw = (SensorRawPacket*)(recvBuffer.data() + 2);
-        uint16_t t = ntohs(raw->rawTemp);
-        uint16_t h = ntohs(raw->rawHumi);
-        uint16_t id = raw->deviceId;
-        uint16_t s = raw->statusCode;
-        uint16_t recvSum = ntohs(raw->checksum);
-        uint16_t calcSum = (uint16_t)(id + t + h + s);
-
-        // 4. У֤
-        if (calcSum != recvSum) {
-            std::cerr << "CheckSum Error! ID:" << id << " Calc:" << calcSum << " Recv:" << recvSum << std::endl;
-            recvBuffer.erase(0, len + 2);
+        if (batch.count == 0) {
+            // 2. 开头不是定长帧：先看是不是握手或多样本帧
+            Extended ext = extendedFrame(recvBuffer, reactor, fd, bucket, version);
+            if (ext == Extended::Done) continue;
+            if (ext == Extended::More) return true; // 等待数据包收全
+            if (ext == Extended::Throttled) return false;
+
+            // 协议鲁棒性检查：错位时跳到下一个可能的同步头，防止由于错位导致整条连接报废
+            size_t skipped = resync(recvBuffer, version >= FRAME_VERSION_MULTI);
+            ++total.resyncs;
+            total.skipped += skipped;
+            logErrors(reactor);
             continue;
         }
 
-        // 5. ҵ߼ת JSON
-        // ע⣺cJSON ʱʹõ Reactor йصڴ
-        cJSON* msg = cJSON_CreateObject();
-        if (msg) {
-            cJSON_AddNumberToObject(msg, "dev_id", id);
-            cJSON_AddNumberToObject(msg, "temp", t / 100.0);
-            cJSON_AddNumberToObject(msg, "humi", h / 100.0);
-            cJSON_AddNumberToObject(msg, "gw_id", 1); // رʶ
-
-            char* msgStr = cJSON_PrintUnformatted(msg);
-            if (msgStr) {
-                struct mosquitto* mosq = reactor->getMosq();
-                int rc = mosquitto_publish(mosq, NULL, "sensor/data", (int)strlen(msgStr), msgStr, 0, false);
-
-                if (rc == MOSQ_ERR_SUCCESS) {
-                    // ޸ġ֪ͨ Reactor  MQTT д¼
-                    // ֻ publish еݲŻ MqttHandler::handleWrite 
-                    if (mosquitto_want_write(mosq)) {
-                        int mosq_fd = mosquitto_socket(mosq);
-                        if (mosq_fd != -1) {
-                            reactor->update(mosq_fd, EPOLLIN | EPOLLOUT);
-                        }
-                    }
+        // 3. 逐帧输出；反压和连接限速都可能停在批中间，没输出的帧留在缓冲区
+        size_t done = 0;
+        bool admitted = true;
+        for (; done < batch.count; ++done)
+        {
+            if (reactor->isIngressPaused()) break;
+            // 连接超速：整帧留在缓冲区里，等令牌攒够再解析
+            if (bucket && !reactor->admitConnection(*bucket)) {
+                admitted = false;
+                break;
+            }
+            // 校验失败的帧同样整帧丢弃
+            if (!batch.valid[done]) {
+                ++total.checksum;
+                logErrors(reactor);
+                continue;
+            }
+            publish(batch.id[done], SensorRawSchema::Temp::scaled(batch.temp[done]), SensorRawSchema::Humi::scaled(batch.humi[done]), reactor, fd);
+        }
+
+        // 4. 消费到最后一个输出的帧，只移动读下标，不搬动后面的数据
+        if (done) recvBuffer.retrieve(done * frameLen);
+        if (!admitted) return false;
+    }
+}
+
+Protocol::Extended Protocol::extendedFrame(Buffer& recvBuffer, IReactor* reactor, int fd, TokenBucket* bucket, uint8_t& version)
+{
+    const uint8_t* data = (const uint8_t*)recvBuffer.data();
+    size_t size = recvBuffer.size();
+    if (size < 2) return Extended::More;
+    size_t len = (size_t)data[0] << 8 | data[1];
+    if (len == sizeof(SensorRawPacket)) return Extended::More;//定长帧没收全
+
+    // 握手：取双方都支持的最高版本回确认，之后这条连接上才认多样本帧；重复握手按最后一次算
+    using Hello = LinkHelloSchema::Packet;
+    if (len == Hello::size) {
+        if (size < 2 + Hello::size) return Extended::More;
+        LinkHello hello = Hello::decode(data + 2);
+        if (hello.magic0 == LINK_MAGIC0 && hello.magic1 == LINK_MAGIC1 && hello.kind == LINK_HELLO) {
+            version = std::clamp<uint8_t>(hello.version, FRAME_VERSION_FIXED, FRAME_VERSION_MAX);
+            uint8_t ack[Hello::size];
+            Hello::encode({ LINK_MAGIC0, LINK_MAGIC1, LINK_ACK, version }, ack);
+            reactor->reply(fd, (const char*)ack, sizeof(ack));
+            recvBuffer.retrieve(2 + Hello::size);
+            return Extended::Done;
+        }
+    }
+
+    // 多样本帧：长度和样本数对得上才当作帧头，一帧只校验一次 CRC、只取一次连接令牌
+    using Multi = SensorMultiSchema;
+    if (version >= FRAME_VERSION_MULTI && len >= Multi::frameLen(1) && len <= Multi::frameLen(FRAME_MULTI_MAX_SAMPLES)) {
+        if (size < 2 + Multi::Header::size) return Extended::More;
+        SensorMultiHeader hdr = Multi::Header::decode(data + 2);
+        if (hdr.type == FRAME_MULTI_TYPE && hdr.count > 0 && len == Multi::frameLen(hdr.count)) {
+            if (size < 2 + len) return Extended::More;
+            if (bucket && !reactor->admitConnection(*bucket)) return Extended::Throttled;
+
+            uint16_t recvCrc = schema::load<uint16_t, Endian::Big>(data + len);
+            if (crc16Ccitt(data, len) != recvCrc) {
+                ++total.checksum;
+                logErrors(reactor);
+            }
+            else {
+                // 一帧的样本全部发布，反压最多越过高水位一帧的样本数
+                const uint8_t* p = data + 2 + Multi::Header::size;
+                int64_t ts = hdr.baseTime;
+                for (size_t i = 0; i < hdr.count; ++i, p += Multi::Sample::size) {
+                    SensorSample sample = Multi::Sample::decode(p);
+                    ts += sample.delta;
+                    publish(hdr.deviceId, Multi::Temp::scaled(sample.temp), Multi::Humi::scaled(sample.humi), reactor, fd, ts);
                 }
-                else {
-                    std::cerr << "MQTT Publish failed: " << mosquitto_strerror(rc) << std::endl;
+            }
+            recvBuffer.retrieve(2 + len);
+            return Extended::Done;
+        }
+    }
+
+    // 不足一个定长帧的数据和以前一样先等，可能只是帧头被拆开了
+    return size < FRAME_WIRE_SIZE ? Extended::More : Extended::Garbage;
+}
+
+bool Protocol::framePublish(const char* payload, IReactor* reactor, int fd)//payload 指向不含长度头的 SensorRawPacket
+{
+    // 3. 按字段表解码，字节序在这一步处理
+    const uint8_t* raw = (const uint8_t*)payload;
+    SensorReading r = SensorRawSchema::Packet::decode(raw);
+
+    // 4. 校验和验证
+    if (!SensorRawSchema::Packet::valid(raw, r)) {
+        ++total.checksum;
+        logErrors(reactor);
+        return false;
+    }
+
+    publish(r.deviceId, SensorRawSchema::Temp::scaled(r.temp), SensorRawSchema::Humi::scaled(r.humi), reactor, fd);
+    return true;
+}
+
+void Protocol::publish(uint8_t id, double temp, double humi, IReactor* reactor, int fd, int64_t ts)
+{
+    // 校验通过才登记下行路由，错位的垃圾数据不会把设备绑到错的连接上
+    if (fd >= 0) reactor->bindDevice(id, fd);
+
+    // 设备超速：丢弃，不占 MQTT 上行带宽
+    if (!reactor->admitDevice(id)) return;
+
+    // 5. 业务逻辑处理：二进制转 JSON
+    // 注意：cJSON 此时使用的是你在 Reactor 中挂载的内存池
+    cJSON* msg = cJSON_CreateObject();
+    if (msg) {
+        cJSON_AddNumberToObject(msg, "dev_id", id);
+        cJSON_AddNumberToObject(msg, "temp", temp);
+        cJSON_AddNumberToObject(msg, "humi", humi);
+        cJSON_AddNumberToObject(msg, "gw_id", 1); // 增加网关标识
+        if (ts >= 0) cJSON_AddNumberToObject(msg, "ts", (double)ts);//多样本帧：设备时钟的毫秒数
+
+        char* msgStr = cJSON_PrintUnformatted(msg);
+        if (msgStr) {
+            struct mosquitto* mosq = reactor->getMosq();
+            reactor->egressQueue();//计入出口积压，超过高水位时停止读取
+            int rc = mosquitto_publish(mosq, NULL, "sensor/data", (int)strlen(msgStr), msgStr, 0, false);
+
+            if (rc == MOSQ_ERR_SUCCESS) {
+                // 【核心修改】主动通知 Reactor 处理 MQTT 写事件
+                // 只有这样，被 publish 进队列的数据才会由 MqttHandler::handleWrite 真正发出
+                if (mosquitto_want_write(mosq)) {
+                    int mosq_fd = mosquitto_socket(mosq);
+                    if (mosq_fd != -1) {
+                        reactor->update(mosq_fd, EPOLLIN | EPOLLOUT);
+                    }
                 }
-                cJSON_free(msgStr); // 黹ڴ
             }
-            cJSON_Delete(msg); // 黹ڴ
+            else {
+                reactor->egressDone();
+                std::cerr << "MQTT Publish failed: " << mosquitto_strerror(rc) << std::endl;
+            }
+            cJSON_free(msgStr); // 归还内存池
+        }
+        cJSON_Delete(msg); // 归还内存池
+    }
+}
+
+void Protocol::datagramParse(const char* data, size_t len, IReactor* reactor)
+{
+    // 一个数据报就是一帧：裸 SensorRawPacket，或者和 TCP 一样带 2 字节长度头（方便固件复用同一套打包代码）
+    if (len == sizeof(SensorRawPacket)) {
+        framePublish(data, reactor);
+        return;
+    }
+    if (len == sizeof(SensorRawPacket) + 2) {
+        uint16_t hdr;
+        memcpy(&hdr, data, 2);
+        if (ntohs(hdr) == sizeof(SensorRawPacket)) {
+            framePublish(data + 2, reactor);
+            return;
+        }
+    }
+    ++total.datagrams;
+    logErrors(reactor);
+}
+
+size_t Protocol::resync(Buffer& recvBuffer, bool multi)
+{
+    // 帧头是大端的 sizeof(SensorRawPacket)：找低字节用 memchr（glibc 里是向量化的），命中后再看前一个字节；
+    // 当前位置已知不是帧头，所以从第 2 个字节开始找低字节
+    const char hi = (char)(sizeof(SensorRawPacket) >> 8);
+    const char lo = (char)(sizeof(SensorRawPacket) & 0xff);
+    const char* begin = recvBuffer.data();
+    const char* end = begin + recvBuffer.size();
+    const char* p = begin + 2;
+    size_t skip;
+    while (true) {
+        p = p < end ? static_cast<const char*>(memchr(p, lo, end - p)) : nullptr;
+        if (!p) {
+            // 没有候选：最后一个字节可能是下一个帧头的前半，留下它
+            skip = end[-1] == hi ? recvBuffer.size() - 1 : recvBuffer.size();
+            break;
         }
+        if (p[-1] == hi) {
+            skip = p - 1 - begin;
+            break;
+        }
+        ++p;
+    }
 
-        // 6. ɹ
-        recvBuffer.erase(0, len + 2);
+    // 多样本帧头：在定长帧候选之前找类型字节，它前面两个字节是长度头，长度要和样本数对得上；
+    // 样本数还没收到的按长度是否可能先留下
+    if (multi) {
+        const char* q = begin + 3;
+        const char* limit = std::min(begin + skip + 2, end);
+        while (q < limit && (q = static_cast<const char*>(memchr(q, FRAME_MULTI_TYPE, limit - q)))) {
+            size_t len = (size_t)(uint8_t)q[-2] << 8 | (uint8_t)q[-1];
+            bool fits = q + 3 < end ? (uint8_t)q[3] > 0 && len == SensorMultiSchema::frameLen((uint8_t)q[3])
+                : len >= SensorMultiSchema::frameLen(1) && len <= SensorMultiSchema::frameLen(FRAME_MULTI_MAX_SAMPLES) && (len - SensorMultiSchema::frameLen(0)) % SensorMultiSchema::Sample::size == 0;
+            if (fits) {
+                skip = q - 2 - begin;
+                break;
+            }
+            ++q;
+        }
     }
+    recvBuffer.retrieve(skip);
+    return skip;
+}
+
+void Protocol::logErrors(IReactor* reactor)
+{
+    uint64_t now = reactor->loopTime();
+    if (lastLog && now - lastLog < PROTOCOL_LOG_INTERVAL_NS) return;
+    std::cerr << "Protocol Error: " << total.resyncs - logged.resyncs << " resyncs skipping "
+        << total.skipped - logged.skipped << " bytes, " << total.checksum - logged.checksum << " checksum errors, "
+        << total.datagrams - logged.datagrams << " bad datagrams";
+    if (lastLog) std::cerr << " in the last " << (now - lastLog) / 1000000 << "ms";
+    std::cerr << std::endl;
+    lastLog = now;
+    logged = total;
 }
\ No newline at end of file
@@ -1,9 +1,46 @@
 #pragma once
-#include "connectionhandler.h"
-#include "reactor.h"
+#include "buffer.h"
+#include "tokenbucket.h"
+#include "framebatch.h"
+#include <cstdint>
+
+#define PROTOCOL_LOG_INTERVAL_NS 1000000000ULL // 协议错误日志的汇总窗口
+
+class IReactor;
 
 class Protocol
 {
 public:
-	void frameParse();
+	// fd 用来登记下行路由；bucket 是连接的令牌桶，令牌不够时停在当前帧并返回 false
+	// version 是连接上协商出的帧格式版本，收到握手时更新并回确认
+	bool frameParse(Buffer& recvBuffer, IReactor* reactor, int fd, TokenBucket* bucket, uint8_t& version);
+	void datagramParse(const char* data, size_t len, IReactor* reactor);//UDP：一个数据报一帧，不需要拼包
+	bool framePublish(const char* payload, IReactor* reactor, int fd = -1);//校验并发布一帧，校验失败返回 false；fd 为 -1 表示无连接（UDP）
+
+	// 协议错误累计数：每个 Reactor 一个 Protocol，只在本线程读写
+	struct Errors
+	{
+		uint64_t resyncs = 0;//帧头错位后重新同步的次数
+		uint64_t skipped = 0;//重新同步时跳过的字节数
+		uint64_t checksum = 0;
+		uint64_t datagrams = 0;//长度不对的 UDP 数据报
+	};
+	const Errors& errors() const { return total; }
+
+private:
+	// 缓冲区开头不是定长帧时调用：握手或多样本帧处理掉返回 Done，没收全返回 More，都不是返回 Garbage，
+	// 多样本帧遇到连接超速返回 Throttled，整帧留在缓冲区
+	enum class Extended { Done, More, Garbage, Throttled };
+	Extended extendedFrame(Buffer& recvBuffer, IReactor* reactor, int fd, TokenBucket* bucket, uint8_t& version);
+	// 已校验的一个读数：登记路由、设备限速、转 JSON 发布；温湿度已按报文描述换算，ts 是设备时钟的毫秒数，-1 表示帧里没有时间戳
+	void publish(uint8_t id, double temp, double humi, IReactor* reactor, int fd, int64_t ts = -1);
+	size_t resync(Buffer& recvBuffer, bool multi);//一次扫到下一个可能的帧头，返回跳过的字节数；multi 时多样本帧头也算
+	// 限速汇总：线路噪声可能让每个字节都出错，逐条写 stderr 会卡住事件循环；
+	// 窗口内第一次出错立即打印，之后只计数，窗口过后随下一次出错打印这段时间的合计（统计快照里总有累计数）
+	void logErrors(IReactor* reactor);
+
+	FrameBatch batch;//frameParse 的解码结果，反复使用
+	Errors total;
+	Errors logged;//上次打印时的累计数
+	uint64_t lastLog = 0;
 };
\ No newline at end of file
@@ -8,94 +8,236 @@ void set_nonblocking(int fd)
 }
 
 
-Reactor::Reactor(int s, struct mosquitto* m) : sockfd(s), mosq(m)
+Reactor::Reactor(int s, struct mosquitto* m) : IReactor(s, m)
 {
-    globalMemoryPool = new MemoryPool(65536, 512, 16);
-    initWheel(getWheel());
-    hooks.malloc_fn = myMalloc;
-    hooks.free_fn = myFree;
-	cJSON_InitHooks(&hooks);
-
     efd = epoll_create(1);
+    // 主从模式下的从 Reactor 没有监听套接字，传入 -1
+    if (sockfd != -1) {
+        ev.events = EPOLLIN | EPOLLET;
+        ev.data.fd = sockfd;
+        epoll_ctl(efd, EPOLL_CTL_ADD, sockfd, &ev);
+    }
+
     ev.events = EPOLLIN | EPOLLET;
-    ev.data.fd = sockfd;
-    epoll_ctl(efd, EPOLL_CTL_ADD, sockfd, &ev);
-    handler[s] = std::make_shared<AcceptHandler>(this);
+    ev.data.fd = wakeupfd;
+    epoll_ctl(efd, EPOLL_CTL_ADD, wakeupfd, &ev);
 }
 
 Reactor::~Reactor()
 {
-    clearTimeWheel(getWheel());
-    delete globalMemoryPool;
+    close(efd);
 }
 
 void Reactor::loop() {
+    stats.start();
     while (1) {
-        int nfds = epoll_wait(efd, events, MAX_EVENTS, -1);
-        for (int i = 0; i < nfds; ++i) {
-            int fd = events[i].data.fd;
-            uint32_t revents = events[i].events;
-
-            // 1. 检查 handler 是否存在（防止之前的循环已经将其删除）
-            if (handler.find(fd) == handler.end()) continue;
+        flushUpdates();
+        // 就绪链表非空时不阻塞，取完已到的事件就回来续读
+        stats.beforeWait();
+        int nfds = waitEvents(hasReady() ? 0 : -1);
+        stats.afterWait(nfds);
+        doReadyList();
+        handleEvents(nfds);
+    }
+}
 
-            // 2. 处理读
-            if (revents & (EPOLLIN | EPOLLPRI | EPOLLRDHUP)) {
-                handler[fd]->handleRead(fd);
+int Reactor::waitEvents(int timeoutMs)
+{
+    if (busyPollUs > 0 && timeoutMs != 0) {
+        // 省掉调度器唤醒：事件通常在空转期间就到了，用 CPU 换延迟
+        uint64_t deadline = LoopStats::now() + (uint64_t)busyPollUs * 1000;
+        do {
+            int nfds = epoll_wait(efd, events, MAX_EVENTS, 0);
+            if (nfds != 0) {
+                stats.spun(true);
+                return nfds;
             }
+        } while (LoopStats::now() < deadline);
+        stats.spun(false);
+    }
+    return epoll_wait(efd, events, MAX_EVENTS, timeoutMs);
+}
+
+void Reactor::setBusyPoll(int us)
+{
+    IReactor::setBusyPoll(us);
+
+    // 网卡支持 NAPI 时让内核在 epoll_wait 里直接轮询网卡队列；不支持的内核返回 ENOTTY，只靠用户态空转
+    struct epoll_params params;
+    memset(&params, 0, sizeof(params));
+    params.busy_poll_usecs = us;
+    params.busy_poll_budget = 64;
+    params.prefer_busy_poll = us > 0;
+    if (ioctl(efd, EPIOCSPARAMS, &params) == -1 && errno != ENOTTY && errno != EINVAL) {
+        perror("ioctl EPIOCSPARAMS");
+    }
+}
+
+void Reactor::handleEvents(int nfds)
+{
+    for (int i = 0; i < nfds; ++i) {
+        int fd = events[i].data.fd;
+        uint32_t revents = events[i].events;
+
+        // 1. 检查 handler 是否存在（防止之前的循环已经将其删除）；回调里可能 remove 自己，先持有一份引用
+        auto it = handler.find(fd);
+        if (it == handler.end()) continue;
+        std::shared_ptr<EventHandler> h = it->second;
+        HandlerKind kind = h->kind();
 
-            // 3. 再次检查，handleRead 可能触发了 remove
-            if (handler.find(fd) != handler.end() && (revents & EPOLLOUT)) {
-                handler[fd]->handleWrite(fd);
+        // 2. 处理读
+        if (revents & (EPOLLIN | EPOLLPRI | EPOLLRDHUP)) {
+            // FIN 和数据可能在同一个边沿里到达，没读满的 readv 之后不会再有通知，告诉连接要读到 0 为止
+            if ((revents & EPOLLRDHUP) && kind == HandlerKind::Connection) {
+                static_cast<ConnectionHandler*>(h.get())->setPeerClosed();
             }
+            h->handleRead(fd);
+        }
+
+        // 3. 再次检查，handleRead 可能触发了 remove
+        if (handler.find(fd) != handler.end() && (revents & EPOLLOUT)) {
+            consumeOut(fd);
+            handler[fd]->handleWrite(fd);
+        }
 
-            // 4. 处理错误
-            if (handler.find(fd) != handler.end() && (revents & (EPOLLERR | EPOLLHUP))) {
+        // 4. 处理错误；MQTT 连接不能直接关掉，交给 MqttHandler 重连
+        if (handler.find(fd) != handler.end() && (revents & (EPOLLERR | EPOLLHUP))) {
+            if (kind == HandlerKind::Mqtt) {
+                static_cast<MqttHandler*>(h.get())->reconnect(fd);
+            }
+            else {
                 close(fd);
                 remove(fd);
             }
         }
+
+        stats.callback(kind);
     }
 }
 
 
 void Reactor::register_(int cfd, uint32_t mode)
 {
+    Interest in = { mode, mode, false };
+    if (ingressPaused) in.blocked = EPOLLIN;//反压期间进来的连接先不读
+    in.applied = in.effective();
+
     struct epoll_event ev;
-    ev.events = mode | EPOLLET;
+    ev.events = in.applied | EPOLLET | EPOLLRDHUP;
     ev.data.fd = cfd;
     epoll_ctl(efd, EPOLL_CTL_ADD, cfd, &ev);
-    handler[cfd] = std::make_shared<ConnectionHandler>(this);
+    interest[cfd] = in;
+    attachConnection(cfd);
 }
 
 
 void Reactor::remove(int cfd)
 {
     epoll_ctl(efd, EPOLL_CTL_DEL, cfd, NULL);
-    handler.erase(cfd);
+    interest.erase(cfd);
+    detach(cfd);
 }
 
 void Reactor::update(int cfd, uint32_t mode)
 {
-    struct epoll_event ev;
-    // 关键：mode 是你想要的权限（如 EPOLLIN | EPOLLOUT），
-    // 但必须重新加上 EPOLLET，因为 epoll_ctl(MOD) 会覆盖掉之前的设置
-    ev.events = mode | EPOLLET;
-    ev.data.fd = cfd;
+    // 只记录，真正的 epoll_ctl 推迟到本轮循环末尾；每发布一帧都会调一次这里
+    auto it = interest.find(cfd);
+    if (it == interest.end()) return;
+    Interest& in = it->second;
+    in.wanted = mode;
+    if (!in.dirty && in.effective() != in.applied) {
+        in.dirty = true;
+        dirtyFds.push_back(cfd);
+    }
+}
 
-    epoll_ctl(efd, EPOLL_CTL_MOD, cfd, &ev);
+void Reactor::block(int fd, uint32_t events)
+{
+    auto it = interest.find(fd);
+    if (it == interest.end()) return;
+    Interest& in = it->second;
+    uint32_t released = in.blocked & ~events;
+    in.blocked = events;
+    // 解除屏蔽时强制 MOD 一次：暂停期间被跳过的读事件在 ET 下不会再来，
+    // MOD 会让内核重新检查就绪状态，已经在接收缓冲区里的数据立即报告
+    in.applied &= ~released;
+    if (!in.dirty && in.effective() != in.applied) {
+        in.dirty = true;
+        dirtyFds.push_back(fd);
+    }
 }
 
-void Reactor::mqtt_heartbeat_cb(void* args)
+void Reactor::flushUpdates()
 {
-    auto p = static_cast<MqttHandler*>(args);
-    p->handleMisc();
-    TimeWheelNode* node = addNewTimer(getWheel(), mqtt_heartbeat_cb, 60000, p);
-    p->setTimer(node);
+    for (int fd : dirtyFds) {
+        auto it = interest.find(fd);
+        if (it == interest.end() || !it->second.dirty) continue;//已注销，或 fd 被复用后重新注册
+        Interest& in = it->second;
+        in.dirty = false;
+        uint32_t mode = in.effective();
+        if (mode == in.applied) continue;//一轮内改过去又改回来
+
+        struct epoll_event ev;
+        // 关键：mode 是你想要的权限（如 EPOLLIN | EPOLLOUT），
+        // 但必须重新加上 EPOLLET 和 EPOLLRDHUP，因为 epoll_ctl(MOD) 会覆盖掉之前的设置
+        // 暂停读取期间到达的 FIN 也在这时重新报告：MOD 会让内核重新检查就绪状态
+        ev.events = mode | EPOLLET | EPOLLRDHUP;
+        ev.data.fd = fd;
+        if (epoll_ctl(efd, EPOLL_CTL_MOD, fd, &ev) == -1) {
+            perror("epoll_ctl mod");
+            continue;
+        }
+        in.applied = mode;
+    }
+    dirtyFds.clear();
+}
+
+void Reactor::consumeOut(int fd)
+{
+    // 边沿触发下 EPOLLOUT 只在 MOD 或缓冲区由满变空时报告一次，
+    // 报告过之后即使掩码里还有 EPOLLOUT 也不会再来，所以当作已经撤销
+    auto it = interest.find(fd);
+    if (it != interest.end()) {
+        it->second.applied &= ~EPOLLOUT;
+    }
 }
 
+void Reactor::udpRegister(int fd)
+{
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.fd = fd;
+    if (epoll_ctl(efd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        perror("epoll_ctl add udp");
+        return;
+    }
+    interest[fd] = { EPOLLIN, EPOLLIN, false };
+    attachUdp(fd);
+}
 
+void Reactor::localRegister(int fd, bool ring)
+{
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.fd = fd;
+    if (epoll_ctl(efd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        perror("epoll_ctl add local");
+        return;
+    }
+    attachLocal(fd, ring);
+}
 
+void Reactor::ringRegister(int fd, const std::shared_ptr<RingHandler>& h)
+{
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.fd = fd;
+    if (epoll_ctl(efd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        perror("epoll_ctl add ring");
+        return;
+    }
+    attachRing(fd, h);
+}
 
 //MQTT
 void Reactor::mqttRegister(int fd, uint32_t mode, const std::shared_ptr<MqttHandler>& ptr, struct mosquitto* mosq)
@@ -109,20 +251,9 @@ void Reactor::mqttRegister(int fd, uint32_t mode, const std::shared_ptr<MqttHand
         perror("epoll_ctl add mqtt");
         return;
     }
+    interest[fd] = { mode, mode, false };
 
-    std::shared_ptr<MqttHandler> p = ptr;
-    if (!p) {
-        p = std::make_shared<MqttHandler>(this);
-        p->setMosq(mosq); // 只有新创建时才设置，旧对象已经持有了
-    }
-    else
-    {
-        cancelTimer(p->getTimer());
-    }
-    TimeWheelNode* node = addNewTimer(getWheel(), mqtt_heartbeat_cb, 60000, p.get());
-    p->setTimer(node);
-
-    handler[fd] = p;
+    attachMqtt(fd, ptr, mosq);
 
 }
 
@@ -3,53 +3,90 @@
 #include <iostream>
 #include <unordered_map>
 #include <memory>
+#include <vector>
+#include <atomic>
 #include <sys/epoll.h>
 #include <netinet/in.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/ioctl.h>
 #include <cstdlib>
 #include <string>
 #include <string.h>
+#include <mosquitto.h>
+#include "cJSON.h"
 #include "timewheel.h"
 #include "memorypool.h"
+#include "IReactor.h"
 #include "mqtthandler.h"
 #include "accepthandler.h"
 #include "connectionhandler.h"
+#include "protocol.h"
+#include "wakeuphandler.h"
+#include "mpscqueue.h"
 
 #define MAX_EVENTS 1024
-#define BUFFER_SIZE 64
-// 设置 fd 为非阻塞（ET 模式必需）
 
+// 内核 6.9 起 epoll 支持按实例设置 busy poll 参数，老头文件里没有
+#ifndef EPIOCSPARAMS
+struct epoll_params
+{
+    uint32_t busy_poll_usecs;
+    uint16_t busy_poll_budget;
+    uint8_t prefer_busy_poll;
+    uint8_t __pad;
+};
+#define EPOLL_IOC_TYPE 0x8A
+#define EPIOCSPARAMS _IOW(EPOLL_IOC_TYPE, 0x01, struct epoll_params)
+#endif
+// 设置 fd 为非阻塞（ET 模式必需）
 
 
-class Reactor
+// epoll 后端
+class Reactor : public IReactor
 {
 private:
-    int sockfd;
-    struct mosquitto* mosq;
     int efd;
     epoll_event ev, events[MAX_EVENTS];
-    std::unordered_map<int, std::shared_ptr<EventHandler>> handler;
-	
-    cJSON_Hooks hooks;
+
+    // 每个 fd 的关注事件缓存：applied 是内核里生效的掩码，wanted 是本轮最后一次 update 的结果
+    struct Interest
+    {
+        uint32_t applied;
+        uint32_t wanted;
+        bool dirty;
+        uint32_t blocked = 0;//反压期间屏蔽的事件，update 照常记录 wanted，提交时扣掉
+
+        uint32_t effective() const { return wanted & ~blocked; }
+    };
+    std::unordered_map<int, Interest> interest;
+    std::vector<int> dirtyFds;//本轮 update 过的 fd，进入 epoll_wait 前统一提交
 
 public:
     explicit Reactor(int s, struct mosquitto* m);
     ~Reactor();
 
-    void loop();
-    void mqttLoop();
-    void register_(int cfd, uint32_t mode);
-    void mqttRegister(int fd, uint32_t mode, const std::shared_ptr<MqttHandler>& ptr, struct mosquitto* mosq);
-    void remove(int cfd);
-    void update(int cfd, uint32_t mode);
-    struct mosquitto* getMosq() { return mosq; }
+    void loop() override;
+    void mqttLoop() override;
+    void register_(int cfd, uint32_t mode) override;
+    void mqttRegister(int fd, uint32_t mode, const std::shared_ptr<MqttHandler>& ptr, struct mosquitto* mosq) override;
+    void remove(int cfd) override;
+    void update(int cfd, uint32_t mode) override;
+    void udpRegister(int fd) override;
+    void localRegister(int fd, bool ring) override;
+    void ringRegister(int fd, const std::shared_ptr<RingHandler>& h) override;
+    void setBusyPoll(int us) override;
 
-    int getSockfd() { return sockfd; }
-    static Wheel* getWheel() { static Wheel wheel; return &wheel; }
-
-    static void mqtt_heartbeat_cb(void* args);
+private:
+    int waitEvents(int timeoutMs);//busyPollUs > 0 时先用 epoll_wait(0) 空转，超时仍无事件再阻塞
+    void handleEvents(int nfds);//分发 epoll_wait 返回的事件
+    void flushUpdates();//把本轮积攒的掩码变化提交给内核，相同的直接丢弃
+    void consumeOut(int fd);//ET 模式下 EPOLLOUT 边沿已被消费，再次需要时必须重新 MOD
+    void block(int fd, uint32_t events);//设置屏蔽的事件并按需排队提交
 
+protected:
+    void pauseRead(int cfd) override { block(cfd, EPOLLIN); }
+    void resumeRead(int cfd) override { block(cfd, 0); }
 };
 
 void set_nonblocking(int fd);
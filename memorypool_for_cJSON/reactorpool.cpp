@@ -0,0 +1,332 @@
+#include "reactorpool.h"
+#include "reactor.h"
+#include "uringreactor.h"
+#include "udphandler.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <cstdio>
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+#include <future>
+#include <chrono>
+
+
+int createListenSocket(uint16_t port, bool reusePort)
+{
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        perror("socket");
+        return -1;
+    }
+
+    int opt = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    // 必须在 bind 之前设置，所有线程的监听套接字绑定到同一端口
+    if (reusePort && setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+        perror("setsockopt SO_REUSEPORT");
+        close(fd);
+        return -1;
+    }
+
+    struct sockaddr_in serveraddr {};
+    serveraddr.sin_family = AF_INET;
+    serveraddr.sin_port = htons(port);
+    serveraddr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+    if (bind(fd, (struct sockaddr*)&serveraddr, sizeof(serveraddr)) < 0) {
+        perror("Bind failed");
+        close(fd);
+        return -1;
+    }
+    // 基站恢复时成批的传感器同时重连，backlog 取系统上限
+    listen(fd, SOMAXCONN);
+    return fd;
+}
+
+
+int createLocalSocket(const std::string& path, int type)
+{
+    struct sockaddr_un addr {};
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "unix socket path too long: %s\n", path.c_str());
+        return -1;
+    }
+    memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    int fd = socket(AF_UNIX, type | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        perror("socket unix");
+        return -1;
+    }
+
+    // 上次进程留下的套接字文件会让 bind 报 EADDRINUSE；只删套接字，路径写错了不能把别的文件删掉
+    struct stat st;
+    if (lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+        unlink(path.c_str());
+    }
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        perror("Bind unix failed");
+        close(fd);
+        return -1;
+    }
+    listen(fd, SOMAXCONN);
+    return fd;
+}
+
+
+static std::unique_ptr<IReactor> createReactor(Backend backend, int s, struct mosquitto* m)
+{
+    if (backend == Backend::Uring) {
+        return std::make_unique<UringReactor>(s, m);
+    }
+    return std::make_unique<Reactor>(s, m);
+}
+
+
+ReactorPool::ReactorPool(int n, uint16_t p, MqttFactory f, PoolMode m, Balance b, Backend e)
+    : threadNum(n > 0 ? n : 1)
+    , port(p)
+    , mqttFactory(std::move(f))
+    , mode(m)
+    , balance(b)
+    , backend(e)
+{
+}
+
+ReactorPool::~ReactorPool()
+{
+    join();
+}
+
+bool ReactorPool::openUdp()
+{
+    if (udpPort == 0) return true;
+    for (int i = 0; i < threadNum; ++i)
+    {
+        int fd = createUdpSocket(udpPort);
+        if (fd == -1) {
+            for (int s : udpfds) close(s);
+            udpfds.clear();
+            return false;
+        }
+        udpfds.push_back(fd);
+    }
+    return true;
+}
+
+bool ReactorPool::openLocal()
+{
+    for (LocalPath& p : localPaths)
+    {
+        p.fd = createLocalSocket(p.path, p.type);
+        if (p.fd == -1) return false;
+    }
+    return true;
+}
+
+void ReactorPool::closeOpened()
+{
+    for (int s : udpfds) close(s);
+    udpfds.clear();
+    for (LocalPath& p : localPaths) {
+        if (p.fd != -1) close(p.fd);
+        p.fd = -1;
+    }
+}
+
+bool ReactorPool::start()
+{
+    // UDP、AF_UNIX 套接字和监听套接字一样先在主线程建好，bind 失败同步报告
+    if (!openUdp() || !openLocal()) {
+        closeOpened();
+        return false;
+    }
+
+    if (mode == PoolMode::MainSub)
+    {
+        int fd = createListenSocket(port, false);
+        if (fd == -1) {
+            closeOpened();
+            return false;
+        }
+
+        workers.assign(threadNum, nullptr);
+        for (int i = 0; i < threadNum; ++i)
+        {
+            threads.emplace_back(&ReactorPool::runWorker, this, i);
+        }
+        threads.emplace_back(&ReactorPool::runAcceptor, this, fd);
+        return true;
+    }
+
+    // 先在主线程里把所有监听套接字建好，bind 失败能同步报告给调用者
+    std::vector<int> listenfds;
+    for (int i = 0; i < threadNum; ++i)
+    {
+        int fd = createListenSocket(port, true);
+        if (fd == -1) {
+            for (int s : listenfds) close(s);
+            closeOpened();
+            return false;
+        }
+        listenfds.push_back(fd);
+    }
+
+    workers.assign(threadNum, nullptr);
+    for (int i = 0; i < threadNum; ++i)
+    {
+        threads.emplace_back(&ReactorPool::run, this, i, listenfds[i]);
+    }
+    return true;
+}
+
+void ReactorPool::join()
+{
+    for (auto& t : threads)
+    {
+        if (t.joinable()) t.join();
+    }
+    threads.clear();
+}
+
+void ReactorPool::run(int index, int listenfd)
+{
+    // Reactor 必须在本线程内构造：thread_local 内存池前端和时间轮都归属于当前线程
+    struct mosquitto* mosq = mqttFactory(index);
+    std::unique_ptr<IReactor> reactor = createReactor(backend, listenfd, mosq);
+
+    int mosqfd = mosquitto_socket(mosq);
+    if (mosqfd != -1) {
+        reactor->mqttRegister(mosqfd, EPOLLIN, nullptr, mosq);
+    }
+    if (!udpfds.empty()) {
+        reactor->udpRegister(udpfds[index]);
+    }
+
+    if (!localPaths.empty()) {
+        // AF_UNIX 没有 SO_REUSEPORT 分流，多个 Reactor 共挂一个监听套接字时新连接几乎总落在同一个线程上；
+        // 改由 0 号 Reactor 统一 accept，按 -b 策略分给各线程
+        std::unique_lock<std::mutex> lock(mutex);
+        workers[index] = reactor.get();
+        ++readyNum;
+        cond.notify_all();
+        if (index == 0) {
+            cond.wait(lock, [this] { return readyNum == threadNum; });
+            reactor->setLocalPeers(workers, balance);
+            for (const LocalPath& p : localPaths) {
+                reactor->localRegister(p.fd, p.ring);
+            }
+        }
+    }
+
+    attach(index, reactor.get());
+    prepare(index, reactor.get());
+    reactor->mqttLoop();
+}
+
+void ReactorPool::runWorker(int index)
+{
+    struct mosquitto* mosq = mqttFactory(index);
+    std::unique_ptr<IReactor> reactor = createReactor(backend, -1, mosq);
+
+    int mosqfd = mosquitto_socket(mosq);
+    if (mosqfd != -1) {
+        reactor->mqttRegister(mosqfd, EPOLLIN, nullptr, mosq);
+    }
+    if (!udpfds.empty()) {
+        reactor->udpRegister(udpfds[index]);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        workers[index] = reactor.get();
+        ++readyNum;
+    }
+    cond.notify_all();
+
+    attach(index, reactor.get());
+    prepare(index, reactor.get());
+    reactor->mqttLoop();
+}
+
+void ReactorPool::runAcceptor(int listenfd)
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [this] { return readyNum == threadNum; });
+    }
+
+    // 主 Reactor 不发布消息，不需要 MQTT 客户端
+    std::unique_ptr<IReactor> reactor = createReactor(backend, listenfd, nullptr);
+    reactor->setSubReactors(workers, balance);
+    // 本机连接也由主 Reactor 接受，按同样的策略移交
+    for (const LocalPath& p : localPaths) {
+        reactor->localRegister(p.fd, p.ring);
+    }
+    attach(threadNum, reactor.get());
+    reactor->loop();
+}
+
+void ReactorPool::attach(int index, IReactor* r)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if ((int)reactors.size() <= index) reactors.resize(index + 1, nullptr);
+    reactors[index] = r;
+}
+
+void ReactorPool::prepare(int index, IReactor* r)
+{
+    if (firstCpu >= 0) {
+        // 忙轮询会占满一个核，应该配合 isolcpus 绑到隔离出来的核上，避免和其他线程互相抢占
+        int ncpu = (int)std::thread::hardware_concurrency();
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET((firstCpu + index) % (ncpu > 0 ? ncpu : 1), &set);
+        int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (rc != 0) {
+            fprintf(stderr, "pthread_setaffinity_np: %s\n", strerror(rc));
+        }
+    }
+    if (busyPollUs > 0) {
+        r->setBusyPoll(busyPollUs);
+    }
+    r->setCoSessions(coSessions);
+    r->setRateLimit(rateLimit);
+}
+
+void ReactorPool::dumpStats(std::ostream& os)
+{
+    std::vector<IReactor*> list;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        list = reactors;
+    }
+
+    for (size_t i = 0; i < list.size(); ++i)
+    {
+        IReactor* r = list[i];
+        if (!r) continue;
+
+        char name[32];
+        if (mode == PoolMode::MainSub && (int)i == threadNum) snprintf(name, sizeof(name), "acceptor");
+        else snprintf(name, sizeof(name), "reactor %zu", i);
+
+        // 统计只在 Reactor 线程内写，投递一个任务到它自己的线程里拷贝；
+        // 超时不等：回调卡住本身就是要找的问题，promise 用 shared_ptr 保证任务晚到时仍然有效
+        auto snapshot = std::make_shared<std::promise<LoopStats>>();
+        std::future<LoopStats> result = snapshot->get_future();
+        r->queueInLoop([r, snapshot] { snapshot->set_value(r->getStats()); });
+        if (result.wait_for(std::chrono::seconds(1)) != std::future_status::ready) {
+            os << name << ": no response within 1s, loop is blocked\n";
+            continue;
+        }
+        result.get().print(os, name);
+    }
+    os.flush();
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <sys/socket.h>
+#include "tokenbucket.h"
+
+struct mosquitto;
+class IReactor;
+enum class Balance : char;
+enum class Backend : char;
+
+// 多 Reactor 线程池，每个工作线程运行自己的 Reactor，拥有独立的内存池前端和时间轮
+// ReusePort：每个线程一个 SO_REUSEPORT 监听套接字，新连接由内核做负载均衡
+// MainSub：额外一个 accept 线程运行主 Reactor，按 Balance 策略把连接移交给工作线程
+enum class PoolMode : char { ReusePort, MainSub };
+
+class ReactorPool
+{
+public:
+    using MqttFactory = std::function<struct mosquitto* (int index)>;//为第 index 个线程创建 MQTT 客户端
+
+    explicit ReactorPool(int n, uint16_t p, MqttFactory f, PoolMode m, Balance b, Backend e);
+    ~ReactorPool();
+    ReactorPool(const ReactorPool&) = delete;
+    ReactorPool& operator=(const ReactorPool&) = delete;
+
+    bool start();//创建监听套接字并启动线程，任一监听套接字创建失败则返回 false
+    void join();
+
+    int size() { return threadNum; }
+
+    void setBusyPoll(int us) { busyPollUs = us; }//在 start 之前调用，0 表示不空转
+    void setCpuAffinity(int first) { firstCpu = first; }//第 i 个 Reactor 线程绑定到 first + i 号核，-1 表示不绑定
+    void setCoSessions(bool on) { coSessions = on; }//连接改用协程会话处理
+    void setUdpPort(uint16_t p) { udpPort = p; }//同时在该端口收 UDP 上报，0 表示不开启
+    void setRateLimit(const RateLimit& r) { rateLimit = r; }
+    // 同时在 AF_UNIX 路径上监听，type 为 SOCK_STREAM 或 SOCK_SEQPACKET，可以调用多次；
+    // 本机采集进程走这里，省掉 TCP 回环的协议栈开销，帧格式和 TCP 完全一样
+    void addLocalPath(const std::string& path, int type) { localPaths.push_back({ path, type, false }); }
+    // 共享内存环的控制套接字（SOCK_SEQPACKET），本机高频生产者连上来领取环，见 shmring.h
+    void addRingPath(const std::string& path) { localPaths.push_back({ path, SOCK_SEQPACKET, true }); }
+
+    void dumpStats(std::ostream& os);//线程安全：依次向各 Reactor 取循环统计快照并打印
+
+private:
+    void run(int index, int listenfd);
+    void runWorker(int index);//MainSub 模式的从 Reactor
+    void runAcceptor(int listenfd);//MainSub 模式的主 Reactor
+    void attach(int index, IReactor* r);//登记已构造好的 Reactor，供 dumpStats 访问
+    void prepare(int index, IReactor* r);//进入事件循环前按配置绑核、开启忙轮询
+    bool openUdp();//为每个工作线程建一个 SO_REUSEPORT 的 UDP 套接字
+    bool openLocal();//每个路径建一个监听套接字
+    void closeOpened();//start 失败时关闭已经建好的 UDP 和 AF_UNIX 套接字
+
+private:
+    int threadNum;
+    uint16_t port;
+    MqttFactory mqttFactory;
+    PoolMode mode;
+    Balance balance;
+    Backend backend;
+    int busyPollUs = 0;
+    int firstCpu = -1;
+    bool coSessions = false;
+    uint16_t udpPort = 0;
+    RateLimit rateLimit;
+    std::vector<int> udpfds;//下标对应工作线程
+    struct LocalPath
+    {
+        std::string path;
+        int type;
+        bool ring;
+        int fd = -1;
+    };
+    std::vector<LocalPath> localPaths;//start 成功后每一项都有 fd
+    std::vector<std::thread> threads;
+
+    // 从 Reactor 在各自线程内构造，全部就绪后主 Reactor 才开始 accept；
+    // reuseport 模式下有 AF_UNIX 监听时同样登记，全部就绪后 0 号 Reactor 才开始接本机连接
+    std::vector<IReactor*> workers;
+    std::vector<IReactor*> reactors;//所有 Reactor，MainSub 模式下最后一个是主 Reactor
+    int readyNum = 0;
+    std::mutex mutex;
+    std::condition_variable cond;
+};
+
+// 创建非阻塞监听套接字，reusePort 为 true 时开启 SO_REUSEPORT，失败返回 -1
+int createListenSocket(uint16_t port, bool reusePort);
+// 创建非阻塞的 AF_UNIX 监听套接字，路径上遗留的旧套接字文件先删掉，失败返回 -1
+int createLocalSocket(const std::string& path, int type);
@@ -0,0 +1,171 @@
+#include "ringhandler.h"
+#include "IReactor.h"
+#include "protocol.h"
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <new>
+
+
+namespace {
+
+// memfd 和 eventfd 放在同一条消息里发出，生产者要么两个都拿到，要么都拿不到
+bool sendFds(int ctl, int memfd, int evfd)
+{
+    uint32_t magic = RING_MAGIC;
+    struct iovec iov = { &magic, sizeof(magic) };
+    union {
+        char buf[CMSG_SPACE(2 * sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    memset(&control, 0, sizeof(control));
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(2 * sizeof(int));
+    int fds[2] = { memfd, evfd };
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    // 新连接的发送缓冲区是空的，非阻塞也能一次发出
+    if (sendmsg(ctl, &msg, MSG_NOSIGNAL) != (ssize_t)sizeof(magic)) {
+        perror("ring sendmsg");
+        return false;
+    }
+    return true;
+}
+
+}
+
+
+RingHandler::~RingHandler()
+{
+    if (ring) munmap(ring, ringMapSize(mask + 1));
+    if (evfd != -1) close(evfd);
+}
+
+bool RingHandler::open(int ctl)
+{
+    int memfd = memfd_create("edgelink-ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (memfd == -1) {
+        perror("memfd_create");
+        return false;
+    }
+    size_t size = ringMapSize(RING_SLOTS);
+    // 大小定下来就封口：生产者截短文件的话网关读映射会收到 SIGBUS
+    if (ftruncate(memfd, size) < 0 || fcntl(memfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0) {
+        perror("ring memfd");
+        close(memfd);
+        return false;
+    }
+    void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+    if (p == MAP_FAILED) {
+        perror("ring mmap");
+        close(memfd);
+        return false;
+    }
+    ring = new (p) ShmRingHeader();
+    ring->magic = RING_MAGIC;
+    ring->version = RING_VERSION;
+    ring->slots = RING_SLOTS;
+    ring->slotSize = sizeof(SensorRawPacket);
+    mask = RING_SLOTS - 1;
+
+    evfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (evfd == -1) {
+        perror("ring eventfd");
+        close(memfd);
+        return false;
+    }
+
+    // memfd 发出去之后网关这边只留映射
+    bool ok = sendFds(ctl, memfd, evfd);
+    close(memfd);
+    if (ok) ctlfd = ctl;
+    return ok;
+}
+
+void RingHandler::handleRead(int fd)
+{
+    if (fd == ctlfd) {
+        // 生产者不在控制连接上发数据，可读只会是它退出了；万一发了也丢掉
+        char scratch[64];
+        ssize_t n = recv(ctlfd, scratch, sizeof(scratch), MSG_DONTWAIT);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            // 退出前写进环的记录照常发布，反压中取不完的只能丢弃
+            if (!drain(fd, mask + 1)) return;
+            uint32_t left = ring->head.load(std::memory_order_acquire) - tail;
+            if (left) fprintf(stderr, "ring fd %d: producer gone, %u records dropped\n", ctlfd, left);
+            shutdown();
+            return;
+        }
+    }
+    else {
+        // 复位计数；就绪链表续取时计数已经是 0，读到 EAGAIN 无所谓
+        eventfd_t value;
+        eventfd_read(evfd, &value);
+    }
+    drain(fd, RING_BUDGET);
+}
+
+bool RingHandler::drain(int fd, size_t budget)
+{
+    const SensorRawPacket* slots = ringRecords(ring);
+    size_t done = 0;
+    while (!reactor->isIngressPaused())
+    {
+        uint32_t head = ring->head.load(std::memory_order_acquire);
+        uint32_t avail = head - tail;
+        if (avail == 0) break;
+        if (avail > mask + 1) {
+            fprintf(stderr, "ring fd %d: corrupt head %u (tail %u), closing\n", ctlfd, head, tail);
+            shutdown();
+            return false;
+        }
+        if (done == budget) {
+            // 预算用完还没取空，生产者看到环非空不会再写 eventfd，下一轮接着取
+            reactor->markReady(fd);
+            break;
+        }
+
+        // 在映射上原地校验发布；publish 可能触发反压，逐条检查
+        uint32_t n = 0;
+        while (n < avail && done < budget && !reactor->isIngressPaused()) {
+            protocol->framePublish(reinterpret_cast<const char*>(&slots[(tail + n) & mask]), reactor);
+            ++n;
+            ++done;
+        }
+        tail += n;
+        reactor->ringConsumed(n);
+
+        // 先让生产者看到腾出的空间再重读 head，和 shmRingPush 里的屏障配对
+        ring->tail.store(tail, std::memory_order_release);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+    return true;
+}
+
+void RingHandler::shutdown()
+{
+    int c = ctlfd;
+    int e = evfd;
+    IReactor* r = reactor;
+    evfd = -1;//先关 eventfd，析构函数不能再关一次；ctlfd 留着，注销时 Reactor 据此扣除负载
+    // 两个表项都删掉时本对象析构，析构函数解除映射
+    r->remove(e);
+    close(e);
+    r->remove(c);
+    close(c);
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include "eventhandler.h"
+#include "shmring.h"
+
+#define RING_BUDGET 1024 // 每次唤醒最多取的记录数，和 UDP 一次唤醒的量相当；剩下的挂到就绪链表下一轮再取
+
+
+// 共享内存环的消费端：一个生产者一个实例，控制连接和 eventfd 两个 fd 共用这个处理器
+// 两个 fd 都只挂读事件：eventfd 可读表示环由空变非空，控制连接可读表示生产者退出
+// 反压期间不取，记录留在环里，环满后由生产者自己决定等待还是丢弃；恢复时 Reactor 把两个 fd 挂到就绪链表
+class RingHandler : public EventHandler
+{
+public:
+    explicit RingHandler(IReactor* r, Protocol* p) : EventHandler(r, p) {}
+    ~RingHandler();
+
+    bool open(int ctl);//建 memfd 和 eventfd、映射并发给生产者，失败返回 false，ctl 由调用者关闭
+    int getEventFd() { return evfd; }
+    int getControlFd() { return ctlfd; }
+
+    void handleRead(int fd) override;
+    void handleWrite(int fd) override {}
+    HandlerKind kind() const override { return HandlerKind::Ring; }
+
+private:
+    bool drain(int fd, size_t budget);//取出最多 budget 条并发布，环被写坏时关闭并返回 false
+    void shutdown();//注销并关闭两个 fd，本对象随之析构，之后不能再碰成员
+
+    ShmRingHeader* ring = nullptr;
+    uint32_t mask = 0;//槽数减一，用自己的副本，不信任共享内存里的 slots
+    uint32_t tail = 0;
+    int ctlfd = -1;
+    int evfd = -1;
+};
@@ -0,0 +1,155 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+
+
+// 编译期报文描述：一种报文 = 一个主机字节序的记录结构 + 一张字段表（成员、偏移、字节序、换算除数）+ 校验策略。
+// 解码、校验、编码都由折叠表达式展开成逐字段的定长读写，编译出来和手写的 ntohs 代码一样，没有运行时解释；
+// 新增一种传感器报文只需要声明记录结构和 Layout，字段越界、重叠在编译期报错。具体报文见 packet.h
+
+enum class Endian { Big, Little };
+
+namespace schema {
+
+template <typename M> struct MemberOf;
+template <typename R, typename T> struct MemberOf<T R::*>
+{
+    using Record = R;
+    using Type = T;
+};
+
+// 逐字节移位拼装，GCC/Clang 会合并成一次读加 bswap；写成 constexpr 以便在编译期验证报文
+template <typename T, Endian E>
+constexpr T load(const uint8_t* p)
+{
+    static_assert(std::is_unsigned_v<T>, "wire fields are unsigned integers");
+    T v = 0;
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        size_t shift = E == Endian::Big ? (sizeof(T) - 1 - i) * 8 : i * 8;
+        v = (T)(v | (T)p[i] << shift);
+    }
+    return v;
+}
+
+template <typename T, Endian E>
+constexpr void store(uint8_t* p, T v)
+{
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        size_t shift = E == Endian::Big ? (sizeof(T) - 1 - i) * 8 : i * 8;
+        p[i] = (uint8_t)(v >> shift);
+    }
+}
+
+template <typename... Fields>
+constexpr bool fits(size_t size)
+{
+    const size_t off[] = { Fields::offset... };
+    const size_t len[] = { Fields::size... };
+    for (size_t i = 0; i < sizeof...(Fields); ++i) {
+        if (off[i] + len[i] > size) return false;
+        for (size_t j = 0; j < i; ++j) {
+            if (off[i] < off[j] + len[j] && off[j] < off[i] + len[i]) return false;
+        }
+    }
+    return true;
+}
+
+// CRC-16/CCITT-FALSE（多项式 0x1021，初值 0xFFFF），按字节查表，表在编译期生成
+// 多样本帧长度可变，装不进定长的 Layout，由 Protocol 对整帧直接调用 crc16Ccitt
+struct Crc16Table
+{
+    uint16_t v[256];
+    constexpr Crc16Table() : v()
+    {
+        for (int i = 0; i < 256; ++i) {
+            uint16_t crc = (uint16_t)(i << 8);
+            for (int k = 0; k < 8; ++k) crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+            v[i] = crc;
+        }
+    }
+};
+inline constexpr Crc16Table crc16Table;
+
+}
+
+constexpr uint16_t crc16Ccitt(const uint8_t* p, size_t n)
+{
+    uint16_t crc = 0xFFFF;
+    while (n--) crc = (uint16_t)((crc << 8) ^ schema::crc16Table.v[((crc >> 8) ^ *p++) & 0xff]);
+    return crc;
+}
+
+namespace schema {
+inline constexpr uint8_t crcCheckInput[] = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+}
+static_assert(crc16Ccitt(schema::crcCheckInput, 9) == 0x29B1, "CRC-16/CCITT-FALSE check value");
+
+
+// 一个字段：Member 是记录里的成员指针，Offset 是在报文里的字节偏移；
+// Divisor 是原始值到物理量的除数（温度 2500 / 100 = 25.00 ℃），1 表示不换算
+template <auto Member, size_t Offset, Endian E = Endian::Big, unsigned Divisor = 1>
+struct Field
+{
+    using Record = typename schema::MemberOf<decltype(Member)>::Record;
+    using Type = typename schema::MemberOf<decltype(Member)>::Type;
+    static constexpr auto member = Member;
+    static constexpr size_t offset = Offset;
+    static constexpr size_t size = sizeof(Type);
+    static constexpr Endian endian = E;
+    static constexpr unsigned divisor = Divisor;
+
+    static constexpr void load(const uint8_t* p, Record& r) { r.*Member = schema::load<Type, E>(p + Offset); }
+    static constexpr void store(const Record& r, uint8_t* p) { schema::store<Type, E>(p + Offset, r.*Member); }
+    static constexpr double scaled(Type raw) { return Divisor == 1 ? (double)raw : (double)raw / Divisor; }
+};
+
+
+// 校验策略：valid 检查解码出的记录（需要时看原始字节），seal 在其他字段编码之后算出校验值写进 Target 字段
+struct NoCheck
+{
+    template <typename R> static constexpr bool valid(const uint8_t*, const R&) { return true; }
+    template <typename R> static constexpr void seal(uint8_t*, R&) {}
+};
+
+// 若干成员按 16 位回绕求和
+template <typename Target, auto... Summed>
+struct Sum16
+{
+    template <typename R> static constexpr uint16_t compute(const R& r) { return (uint16_t)(0 + ... + (r.*Summed)); }
+    template <typename R> static constexpr bool valid(const uint8_t*, const R& r) { return compute(r) == r.*Target::member; }
+    template <typename R> static constexpr void seal(uint8_t* p, R& r)
+    {
+        r.*Target::member = compute(r);
+        Target::store(r, p);
+    }
+};
+
+
+// 定长报文：Size 字节，Check 是校验策略，Fields 是字段表（不要求覆盖所有字节，没列出的是保留位）
+template <typename Record, size_t Size, typename Check, typename... Fields>
+struct Layout
+{
+    static_assert(sizeof...(Fields) > 0, "layout needs at least one field");
+    static_assert((std::is_same_v<typename Fields::Record, Record> && ...), "fields must belong to the record");
+    static_assert(schema::fits<Fields...>(Size), "fields overlap or run past the packet size");
+
+    static constexpr size_t size = Size;
+
+    static constexpr Record decode(const uint8_t* p)
+    {
+        Record r{};
+        (Fields::load(p, r), ...);
+        return r;
+    }
+
+    static constexpr bool valid(const uint8_t* p, const Record& r) { return Check::valid(p, r); }
+
+    // 编码到 p（至少 Size 字节，保留位清零），校验字段由 Check 计算，r 里的值被忽略
+    static constexpr void encode(Record r, uint8_t* p)
+    {
+        for (size_t i = 0; i < Size; ++i) p[i] = 0;
+        (Fields::store(r, p), ...);
+        Check::seal(p, r);
+    }
+};
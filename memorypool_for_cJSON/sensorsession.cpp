@@ -0,0 +1,20 @@
+#include "sensorsession.h"
+#include "protocol.h"
+
+#include <cstdio>
+
+
+CoTask SensorSession::run(int fd)
+{
+    // 结果先落到局部变量：GCC 12 对 if 条件里的 co_await 生成的协程帧布局有误
+    bool got = co_await read(FIRST_FRAME_TIMEOUT_MS);
+    if (!got) {
+        fprintf(stderr, "fd %d: no data within %d ms, closing\n", fd, FIRST_FRAME_TIMEOUT_MS);
+        co_return;
+    }
+
+    while (true) {
+        if (!protocol->frameParse(recvBuffer, reactor, fd, &bucket, frameVersion)) throttle(fd);
+        co_await read();
+    }
+}
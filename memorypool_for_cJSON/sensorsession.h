@@ -0,0 +1,15 @@
+#pragma once
+#include "coconnectionhandler.h"
+
+#define FIRST_FRAME_TIMEOUT_MS 5000 // 连上后这么久还没有数据的不是传感器（端口扫描、半开连接），直接断开
+
+
+// 传感器上报会话：协程版的 ConnectionHandler，等首包限时，之后逐批解析上报
+class SensorSession : public CoConnectionHandler
+{
+protected:
+    CoTask run(int fd) override;
+
+public:
+    explicit SensorSession(IReactor* r, Protocol* p) : CoConnectionHandler(r, p) {}
+};
@@ -0,0 +1,66 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <sys/eventfd.h>
+#include "packet.h"
+
+#define RING_MAGIC 0x474e5252 // "RRNG"，控制连接上随 fd 一起发出，生产者据此确认连对了套接字
+#define RING_VERSION 1
+#define RING_SLOTS 65536 // 每个生产者一个环的记录数，必须是 2 的幂；64K 条 × 8 字节
+#define RING_DATA_OFFSET 4096 // 头部单独占一页，记录区从第二页开始
+
+
+// 共享内存单生产者单消费者环：本机的高频生产者直接把 SensorRawPacket（字段仍是大端）写进和网关共享的内存，
+// 不经过 socket，网关在映射上原地校验发布，不拷贝
+//
+// 建立：生产者连上 -g 指定的 SOCK_SEQPACKET 控制套接字，网关建好 memfd 和 eventfd，用一条 SCM_RIGHTS 消息
+// （载荷是 4 字节 RING_MAGIC）发给生产者；memfd 已封口，生产者不能截短它让网关访问映射时收到 SIGBUS。
+// 控制连接一直保持，生产者关闭它就表示退出，网关取完环里剩下的记录后回收
+//
+// head / tail 是只增不减的记录计数，下标为计数取模 slots；head 只由生产者写，tail 只由网关写
+// 唤醒只发生在环由空变非空时：生产者发布 head 后查看 tail 是否等于发布前的 head，
+// 网关写回 tail 后重读 head，两边各隔一次全屏障，至少有一方能看到对方的写入，不会两边都以为对方会处理
+struct ShmRingHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slots;
+    uint32_t slotSize;//sizeof(SensorRawPacket)
+    alignas(64) std::atomic<uint32_t> head;//生产者和网关各自写的计数分在不同缓存行上
+    alignas(64) std::atomic<uint32_t> tail;
+};
+static_assert(sizeof(ShmRingHeader) <= RING_DATA_OFFSET, "ring header must fit in the first page");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "ring counters are shared across processes");
+
+inline size_t ringMapSize(uint32_t slots)
+{
+    return RING_DATA_OFFSET + (size_t)slots * sizeof(SensorRawPacket);
+}
+
+inline SensorRawPacket* ringRecords(ShmRingHeader* ring)
+{
+    return reinterpret_cast<SensorRawPacket*>(reinterpret_cast<char*>(ring) + RING_DATA_OFFSET);
+}
+
+// 生产者侧：写入最多 n 条记录，返回实际写入的条数，环满时少于 n；环由空变非空时写 evfd 唤醒网关
+inline size_t shmRingPush(ShmRingHeader* ring, const SensorRawPacket* recs, size_t n, int evfd)
+{
+    uint32_t head = ring->head.load(std::memory_order_relaxed);
+    uint32_t tail = ring->tail.load(std::memory_order_acquire);
+    size_t room = ring->slots - (head - tail);
+    if (n > room) n = room;
+    if (n == 0) return 0;
+
+    SensorRawPacket* slots = ringRecords(ring);
+    for (size_t i = 0; i < n; ++i) {
+        slots[(head + i) & (ring->slots - 1)] = recs[i];
+    }
+    ring->head.store(head + (uint32_t)n, std::memory_order_release);
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (ring->tail.load(std::memory_order_relaxed) == head) {
+        eventfd_write(evfd, 1);
+    }
+    return n;
+}
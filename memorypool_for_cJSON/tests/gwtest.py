@@ -0,0 +1,178 @@
+# 集成测试公用：启动网关进程、造帧
+# 网关固定监听 2048 端口，测试只能逐个跑；不需要 MQTT broker，连不上时网关照常收帧
+# 下行命令相关的测试用 FakeBroker 在 1883 端口顶替 broker，本机不能另有 broker 在跑
+import os, signal, socket, struct, subprocess, sys, threading, time
+
+PORT = 2048
+
+
+def gateway_path():
+    if len(sys.argv) < 2:
+        sys.exit("usage: %s path/to/gateway" % sys.argv[0])
+    return sys.argv[1]
+
+
+class Gateway:
+    def __init__(self, *args):
+        self.proc = subprocess.Popen([gateway_path()] + list(args),
+                                     stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+        deadline = time.time() + 5
+        while time.time() < deadline:
+            try:
+                socket.create_connection(("127.0.0.1", PORT), timeout=0.2).close()
+                return
+            except OSError:
+                time.sleep(0.05)
+        self.stop()
+        sys.exit("gateway did not start listening on port %d" % PORT)
+
+    def rss_kb(self):
+        with open("/proc/%d/status" % self.proc.pid) as f:
+            for line in f:
+                if line.startswith("VmRSS:"):
+                    return int(line.split()[1])
+        return 0
+
+    def stop(self):
+        if self.proc.poll() is None:
+            self.proc.send_signal(signal.SIGTERM)
+            try:
+                self.proc.wait(3)
+            except subprocess.TimeoutExpired:
+                self.proc.kill()
+                self.proc.wait()
+            # io_uring 实例在进程退出后异步回收，监听套接字会多留一会；等端口真正关掉，
+            # 否则下一个网关 bind 失败，而它的启动探测连上的是这个旧套接字
+            deadline = time.time() + 5
+            while time.time() < deadline:
+                try:
+                    socket.create_connection(("127.0.0.1", PORT), timeout=0.2).close()
+                    time.sleep(0.05)
+                except OSError:
+                    break
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.stop()
+
+
+class FakeBroker:
+    """最小的 MQTT 3.1.1 broker：应答 CONNECT / SUBSCRIBE / PINGREQ，丢弃网关的上报，
+    command() 把一条下行命令发给订阅了命令主题的客户端。要在网关启动之前创建"""
+    MQTT_PORT = 1883
+
+    def __init__(self):
+        self.sock = socket.socket()
+        self.sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        self.sock.bind(("127.0.0.1", self.MQTT_PORT))
+        self.sock.listen(16)
+        self.subscriber = None
+        self.subscribed = threading.Event()
+        threading.Thread(target=self._accept, daemon=True).start()
+
+    def _accept(self):
+        while True:
+            try:
+                c, _ = self.sock.accept()
+            except OSError:
+                return
+            threading.Thread(target=self._serve, args=(c,), daemon=True).start()
+
+    @staticmethod
+    def _recv_exact(c, n):
+        data = b""
+        while len(data) < n:
+            chunk = c.recv(n - len(data))
+            if not chunk:
+                raise OSError("closed")
+            data += chunk
+        return data
+
+    def _serve(self, c):
+        try:
+            while True:
+                kind = self._recv_exact(c, 1)[0] >> 4
+                length, shift = 0, 0
+                while True:
+                    b = self._recv_exact(c, 1)[0]
+                    length |= (b & 0x7f) << shift
+                    shift += 7
+                    if not b & 0x80:
+                        break
+                body = self._recv_exact(c, length)
+                if kind == 1:  # CONNECT
+                    c.sendall(b"\x20\x02\x00\x00")
+                elif kind == 8:  # SUBSCRIBE：报文标识 + 若干 {主题, QoS}
+                    pos, topics = 2, []
+                    while pos < len(body):
+                        n = struct.unpack(">H", body[pos:pos + 2])[0]
+                        topics.append(body[pos + 2:pos + 2 + n].decode())
+                        pos += 2 + n + 1
+                    c.sendall(bytes([0x90, 2 + len(topics)]) + body[:2] + b"\x00" * len(topics))
+                    if "sensor/cmd/+" in topics:
+                        self.subscriber = c
+                        self.subscribed.set()
+                elif kind == 12:  # PINGREQ
+                    c.sendall(b"\xd0\x00")
+                elif kind == 14:  # DISCONNECT
+                    break
+        except OSError:
+            pass
+        c.close()
+
+    def command(self, dev, payload):
+        topic = ("sensor/cmd/%d" % dev).encode()
+        body = struct.pack(">H", len(topic)) + topic + payload
+        assert len(body) < 128
+        self.subscriber.sendall(bytes([0x30, len(body)]) + body)
+
+    def drop(self):
+        """断开订阅命令主题的客户端，模拟 broker 重启或网络闪断"""
+        self.subscriber.shutdown(socket.SHUT_RDWR)
+
+    def close(self):
+        # 只 close 唤不醒阻塞在 accept 里的线程，监听套接字会一直留着；先 shutdown
+        try:
+            self.sock.shutdown(socket.SHUT_RDWR)
+        except OSError:
+            pass
+        self.sock.close()
+
+
+def frame(dev, temp=2500, humi=6000, status=0):
+    """定长帧：2 字节大端长度头 + SensorRawPacket"""
+    checksum = (dev + temp + humi + status) & 0xffff
+    return struct.pack(">HBHHBH", 8, dev, temp, humi, status, checksum)
+
+
+def connect():
+    return socket.create_connection(("127.0.0.1", PORT))
+
+
+def downlink(payload):
+    """网关发给设备的下行帧：2 字节大端长度头 + 载荷"""
+    return struct.pack(">H", len(payload)) + payload
+
+
+def receive(sock, expect, timeout=2):
+    """读到 expect 出现、对端关闭或超时为止，返回读到的全部数据"""
+    got = b""
+    sock.settimeout(timeout)
+    try:
+        while expect not in got:
+            chunk = sock.recv(256)
+            if not chunk:
+                break
+            got += chunk
+    except socket.timeout:
+        pass
+    return got
+
+
+def check(cond, msg):
+    if not cond:
+        print("FAIL: " + msg)
+        sys.exit(1)
+    print("ok: " + msg)
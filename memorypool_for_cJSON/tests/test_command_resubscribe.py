@@ -0,0 +1,35 @@
+# 下行命令靠 0 号 MQTT 客户端订阅 sensor/cmd/+，客户端是 clean session，broker 不保留订阅：
+# 断线重连之后、以及启动时 broker 还没起来的情况下，都要在连上时重新订阅，否则命令通道悄悄失效
+import time
+from gwtest import Gateway, FakeBroker, frame, connect, downlink, receive, check
+
+
+def command_delivered(broker, dev):
+    s = connect()
+    s.sendall(frame(dev))
+    time.sleep(0.3)
+    broker.command(dev, b"hello")
+    expect = downlink(b"hello")
+    got = receive(s, expect)
+    s.close()
+    return got == expect
+
+
+for backend in ("epoll", "uring"):
+    # broker 断开连接：网关重连后重新订阅
+    broker = FakeBroker()
+    with Gateway("-t", "1", "-e", backend) as gw:
+        check(broker.subscribed.wait(5), "%s: gateway subscribed to the command topic" % backend)
+        broker.subscribed.clear()
+        broker.drop()
+        check(broker.subscribed.wait(5), "%s: gateway subscribed again after reconnecting" % backend)
+        check(command_delivered(broker, 9), "%s: command delivered after reconnect" % backend)
+    broker.close()
+
+    # 网关先启动，broker 后起来
+    with Gateway("-t", "1", "-e", backend) as gw:
+        time.sleep(1)
+        broker = FakeBroker()
+        check(broker.subscribed.wait(5), "%s: gateway subscribed once the broker came up" % backend)
+        check(command_delivered(broker, 9), "%s: command delivered after late broker start" % backend)
+    broker.close()
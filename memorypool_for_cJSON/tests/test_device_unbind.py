@@ -0,0 +1,54 @@
+# 一条连接转发多个设备的帧时，断开要撤销其中每个设备的下行路由：
+# 只撤销最后一个的话，其余设备的命令会投递给之后复用同一 fd 号的新连接
+import time
+from gwtest import Gateway, FakeBroker, frame, connect, downlink, receive, check
+
+
+broker = FakeBroker()
+for backend in ("epoll", "uring"):
+    broker.subscribed.clear()
+    with Gateway("-t", "1", "-e", backend) as gw:
+        check(broker.subscribed.wait(5), "%s: gateway subscribed to the command topic" % backend)
+
+        # 连接 A 先后上报设备 5 和 6，然后断开；连接 B 接着连上，拿到同一个 fd 号，上报设备 7
+        a = connect()
+        a.sendall(frame(5) + frame(6))
+        time.sleep(0.3)
+        a.close()
+        time.sleep(0.3)
+        b = connect()
+        b.sendall(frame(7))
+        time.sleep(0.3)
+
+        # 命令按顺序投递：发给 5、6 的如果错投给 B，会排在发给 7 的前面
+        broker.command(5, b"stale-5")
+        broker.command(6, b"stale-6")
+        broker.command(7, b"hello-7")
+        expect = downlink(b"hello-7")
+        got = receive(b, expect)
+        b.close()
+        check(got == expect, "%s: new connection only receives its own command (got %r)" % (backend, got))
+
+    # 同一设备先后出现在两个 Reactor 上：后来的连接断开会清掉设备的归属，
+    # 原来那条连接接着上报时要重新登记，命令不能因为"设备不在线"被丢弃
+    broker.subscribed.clear()
+    with Gateway("-t", "2", "-m", "mainsub", "-b", "rr", "-e", backend) as gw:
+        check(broker.subscribed.wait(5), "%s: gateway subscribed to the command topic" % backend)
+
+        a = connect()  # 轮询分配：a 和 b 落在不同的 Reactor 上
+        a.sendall(frame(5))
+        time.sleep(0.3)
+        b = connect()
+        b.sendall(frame(5))
+        time.sleep(0.3)
+        b.close()
+        time.sleep(0.3)
+        a.sendall(frame(5))
+        time.sleep(0.3)
+
+        broker.command(5, b"hello-5")
+        expect = downlink(b"hello-5")
+        got = receive(a, expect)
+        a.close()
+        check(got == expect, "%s: device still reachable after its other connection closed (got %r)" % (backend, got))
+broker.close()
@@ -0,0 +1,26 @@
+# 边沿触发下对端关闭不能丢：数据和 FIN 一起到达时，一次没读满的 readv 只拿走数据，
+# FIN 不会再产生新的边沿；网关必须照样读到 0 并关闭连接，否则连接堆积在 CLOSE_WAIT
+import socket, time
+from gwtest import Gateway, frame, connect, check
+
+CONNS = 50
+
+for backend in ("epoll", "uring"):
+    with Gateway("-t", "1", "-e", backend) as gw:
+        socks = []
+        for i in range(CONNS):
+            s = connect()
+            # 一帧半：数据和 FIN 紧挨着发出
+            s.sendall(frame(1) + frame(2)[:5])
+            s.shutdown(socket.SHUT_WR)
+            socks.append(s)
+        closed = 0
+        for s in socks:
+            s.settimeout(2)
+            try:
+                if s.recv(16) == b"":
+                    closed += 1
+            except socket.timeout:
+                pass
+            s.close()
+        check(closed == CONNS, "%s: gateway closed %d/%d half-closed connections" % (backend, closed, CONNS))
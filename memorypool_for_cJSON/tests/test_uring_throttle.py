@@ -0,0 +1,26 @@
+# 连接限速在 io_uring 后端上必须真正停止接收：
+# 限速 50 帧/秒的连接往里猛灌，网关只能按令牌消费，剩下的应当堵在内核缓冲区里让发送端写不动，
+# 而不是被续挂的 recv 读进接收缓冲区无限增长
+import socket, time
+from gwtest import Gateway, frame, connect, check
+
+SEND_SECONDS = 3
+LIMIT_BYTES = 16 << 20  # 远大于两端内核缓冲区之和，远小于不限速时 3 秒能灌进去的量
+
+with Gateway("-t", "1", "-e", "uring", "-r", "0,50") as gw:
+    rss0 = gw.rss_kb()
+    s = connect()
+    s.setblocking(False)
+    chunk = frame(1) * 6000
+    sent = 0
+    deadline = time.time() + SEND_SECONDS
+    while time.time() < deadline:
+        try:
+            sent += s.send(chunk)
+        except BlockingIOError:
+            time.sleep(0.01)
+    rss1 = gw.rss_kb()
+    check(sent < LIMIT_BYTES, "throttled connection stalls the sender (%d bytes accepted)" % sent)
+    check(rss1 - rss0 < 32 << 10, "gateway memory stays bounded (%d KB growth)" % (rss1 - rss0))
+    check(gw.proc.poll() is None, "gateway still running")
+    s.close()
@@ -31,7 +31,14 @@ void reAddTimer(Wheel* wheel, TimeWheelNode* node)
     uint64_t delay = expire - current;
 
     int pos;
-    if (delay < TVR_SIZE)
+    if (expire <= current)
+    {
+        // 降级时已经过期（一次 tick 跨过了到期点）：放进 L1 当前槽，本轮或下一轮执行，
+        // 否则 delay 回绕成超大值会被当成超范围直接释放，回调不执行且持有者拿着野指针
+        pos = current & TVR_MASK;
+        insertTimer(&wheel->wheelL1[pos], node);
+    }
+    else if (delay < TVR_SIZE)
     {
         pos = expire & TVR_MASK;
         insertTimer(&wheel->wheelL1[pos], node);
@@ -58,13 +65,13 @@ void reAddTimer(Wheel* wheel, TimeWheelNode* node)
     }
     else
     {
-        // ַ֧Χ
+        // 超出支持范围，丢弃
         free(node);
         return;
     }
 }
 
-//  L2~L5ֻ cascadeִ
+// 用于 L2~L5：只 cascade，不执行
 static void cascadeLevel(TimeWheelNode** wheel, int size, int level, uint64_t last, uint64_t now, Wheel* w)
 {
 
@@ -112,7 +119,7 @@ static void cascadeLevel(TimeWheelNode** wheel, int size, int level, uint64_t la
             while (head)
             {
                 TimeWheelNode* next = head->next;
-                reAddTimer(w, head); // ²ʱ
+                reAddTimer(w, head); // 重新插入时间轮
                 head = next;
             }
         }
@@ -128,7 +135,7 @@ static void cascadeLevel(TimeWheelNode** wheel, int size, int level, uint64_t la
                 while (head)
                 {
                     TimeWheelNode* next = head->next;
-                    reAddTimer(w, head); // ²ʱ
+                    reAddTimer(w, head); // 重新插入时间轮
                     head = next;
                 }
             }
@@ -163,7 +170,7 @@ static void cascadeLevel(TimeWheelNode** wheel, int size, int level, uint64_t la
 
 }
 
-//  L1ִѵڵ
+// 用于 L1：执行已到期的
 static void execTimerL1(TimeWheelNode** wheel, int size, uint64_t last, uint64_t now)
 {
     int begin = last & TVR_MASK;
@@ -293,7 +300,7 @@ TimeWheelNode* addNewTimer(Wheel* wheel, callback func, uint64_t delay, void* ar
     }
 
     uint64_t current = get_monotonic_ms();
-    // ֹcurrent + delay ܻƣ expire ЧֻҪ delay <= MAX
+    // 防止溢出：current + delay 可能回绕，但 expire 仍有效（只要 delay <= MAX）
     uint64_t expire = current + delay; // unsigned arithmetic is well-defined
 
     TimeWheelNode* node = malloc(sizeof(TimeWheelNode));
@@ -335,7 +342,7 @@ TimeWheelNode* addNewTimer(Wheel* wheel, callback func, uint64_t delay, void* ar
     }
     else
     {
-        // ַ֧Χ
+        // 超出支持范围，丢弃
         free(node);
         return NULL;
     }
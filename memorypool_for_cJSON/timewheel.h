@@ -17,7 +17,7 @@ extern "C" {
 #include <stdbool.h>
 #include <time.h>
 
-// ʱֲ㼶2 ݣ
+// 时间轮层级参数（2 的幂）
 #define TVR_BITS 8 // L1: 2^8 = 256 slots
 #define TVN_BITS 6 // L2~L5: 2^6 = 64 slots
 
@@ -27,7 +27,7 @@ extern "C" {
 #define TVR_MASK (TVR_SIZE - 1) // 0xFF
 #define TVN_MASK (TVN_SIZE - 1) // 0x3F
 
-// ֧ӳ٣2^(8 + 4*6) = 2^32 = 4294967296 uint64_t Ϊ 4294967295
+// 最大支持延迟：2^(8 + 4*6) = 2^32 = 4294967296，但 uint64_t 最大为 4294967295
 #define MAX_SUPPORTED_DELAY (UINT32_MAX)
 
 typedef void (*callback)(void*);
@@ -0,0 +1,59 @@
+#pragma once
+#include <cstdint>
+#include <algorithm>
+
+#define TOKEN_SCALE 1000 // 令牌按千分之一帧计，整数运算里保留补充的零头
+#define TOKEN_IDLE_NS 60000000000ULL // 空闲超过这么久直接补满，避免乘法溢出
+
+
+// 令牌桶：rate 为每秒帧数，burst 为桶容量（帧）
+// 不自己取时间，由调用方传入事件循环缓存的时刻，逐帧判断时没有系统调用；补充是惰性的，只在取令牌时按流逝的时间计算
+struct TokenBucket
+{
+    uint64_t last = 0;//上次补充到的时刻（ns），0 表示还没用过
+    uint64_t tokens = 0;
+
+    bool take(uint64_t now, uint32_t rate, uint32_t burst)
+    {
+        refill(now, rate, burst);
+        if (tokens < TOKEN_SCALE) return false;
+        tokens -= TOKEN_SCALE;
+        return true;
+    }
+
+    // 距离攒够下一帧令牌还要多少毫秒，向上取整
+    uint32_t waitMs(uint32_t rate) const
+    {
+        if (tokens >= TOKEN_SCALE) return 0;
+        uint64_t ns = (TOKEN_SCALE - tokens) * 1000000ULL / rate;
+        return (uint32_t)(ns / 1000000 + 1);
+    }
+
+private:
+    void refill(uint64_t now, uint32_t rate, uint32_t burst)
+    {
+        uint64_t cap = (uint64_t)burst * TOKEN_SCALE;
+        if (last == 0 || now - last >= TOKEN_IDLE_NS) {
+            tokens = cap;
+            last = now;
+            return;
+        }
+        if (now <= last) return;
+
+        // 每纳秒补 rate / 1e6 个千分之一帧；只把换成整数令牌的那段时间记进 last，零头留到下次
+        uint64_t add = (now - last) * rate / 1000000;
+        if (add == 0) return;
+        tokens = std::min(cap, tokens + add);
+        last += add * 1000000 / rate;
+    }
+};
+
+// 限速配置，单位帧/秒，0 表示不限；桶容量即允许的突发帧数
+// 设备超速的帧直接丢弃；连接超速时停止读取，攒够令牌再继续，数据留在内核里由 TCP 流控挡住
+struct RateLimit
+{
+    uint32_t deviceRate = 0;
+    uint32_t deviceBurst = 0;
+    uint32_t connRate = 0;
+    uint32_t connBurst = 0;
+};
@@ -0,0 +1,78 @@
+#include "udphandler.h"
+#include "reactor.h"
+
+#include <netinet/in.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+
+
+UdpHandler::UdpHandler(IReactor* r, Protocol* p) : EventHandler(r, p)
+{
+    // 接收描述每批复用，recvmmsg 只改写 msg_len 和 msg_flags
+    memset(msgs, 0, sizeof(msgs));
+    for (int i = 0; i < UDP_BATCH; ++i) {
+        iovs[i].iov_base = bufs[i];
+        iovs[i].iov_len = UDP_DGRAM_MAX;
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+}
+
+void UdpHandler::handleRead(int fd)
+{
+    // 反压期间不收，数据报留在内核缓冲区里，满了由内核丢弃；恢复时 Reactor 把本 fd 挂到就绪链表
+    if (reactor->isIngressPaused()) return;
+
+    for (int round = 0; round < UDP_BUDGET; ++round) {
+        int n = recvmmsg(fd, msgs, UDP_BATCH, MSG_DONTWAIT, nullptr);
+        if (n < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                perror("recvmmsg");
+            }
+            return;
+        }
+
+        for (int i = 0; i < n; ++i) {
+            // 截断的数据报长度对不上帧，由 datagramParse 当作坏数据报汇总计数
+            protocol->datagramParse(bufs[i], msgs[i].msg_len, reactor);
+        }
+
+        if (n < UDP_BATCH) return;//不满一批说明已经收空
+        if (reactor->isIngressPaused()) return;
+    }
+
+    // 预算用完还没收空，ET 不会再通知，下一轮接着收
+    reactor->markReady(fd);
+}
+
+int createUdpSocket(uint16_t port)
+{
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        perror("socket udp");
+        return -1;
+    }
+
+    int opt = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+        perror("setsockopt SO_REUSEPORT");
+        close(fd);
+        return -1;
+    }
+    int rcvbuf = UDP_RCVBUF;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    struct sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        perror("Bind udp failed");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
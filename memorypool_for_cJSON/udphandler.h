@@ -0,0 +1,29 @@
+#pragma once
+#include "eventhandler.h"
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#define UDP_BATCH 64 // 一次 recvmmsg 最多收的数据报数
+#define UDP_DGRAM_MAX 64 // 单个数据报的接收缓冲区，帧只有 8~10 字节，更大的按截断丢弃
+#define UDP_BUDGET 16 // 每次唤醒最多收这么多批，防止 UDP 洪水独占事件循环
+#define UDP_RCVBUF (1 << 20) // 传感器成批上报时靠内核缓冲区削峰
+
+
+// UDP 上报处理器：低功耗传感器发完即走，不建连接，一个数据报就是一帧
+// 每个 Reactor 一个 SO_REUSEPORT 套接字，用 recvmmsg 成批收取，校验和发布与 TCP 走同一条路径
+class UdpHandler : public EventHandler
+{
+public:
+    void handleRead(int fd) override;
+    void handleWrite(int fd) override {}
+    HandlerKind kind() const override { return HandlerKind::Udp; }
+    explicit UdpHandler(IReactor* r, Protocol* p);
+
+private:
+    struct mmsghdr msgs[UDP_BATCH];
+    struct iovec iovs[UDP_BATCH];
+    char bufs[UDP_BATCH][UDP_DGRAM_MAX];
+};
+
+// 创建非阻塞 UDP 套接字并绑定端口，开启 SO_REUSEPORT 让各 Reactor 分摊，失败返回 -1
+int createUdpSocket(uint16_t port);
@@ -0,0 +1,464 @@
+#include "uringreactor.h"
+#include "accepthandler.h"
+#include "connectionhandler.h"
+#include "mqtthandler.h"
+
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+
+bool UringReactor::supported()
+{
+    struct io_uring r;
+    if (io_uring_queue_init(8, &r, 0) < 0) return false;
+    int ret;
+    struct io_uring_buf_ring* br = io_uring_setup_buf_ring(&r, 8, URING_BGID, 0, &ret);
+    if (br) io_uring_free_buf_ring(&r, br, 8, URING_BGID);
+    io_uring_queue_exit(&r);
+    return br != nullptr;
+}
+
+UringReactor::UringReactor(int s, struct mosquitto* m) : IReactor(s, m)
+{
+    // Reactor 只在自己的线程里提交，可以开 SINGLE_ISSUER；老内核不认识这些标志就退回默认参数
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN | IORING_SETUP_SINGLE_ISSUER;
+    int ret = io_uring_queue_init_params(URING_ENTRIES, &ring, &params);
+    if (ret == -EINVAL) {
+        ret = io_uring_queue_init(URING_ENTRIES, &ring, 0);
+    }
+    if (ret < 0) {
+        std::cerr << "io_uring_queue_init: " << strerror(-ret) << std::endl;
+        abort();
+    }
+
+    bufBase = new char[URING_BUF_COUNT * URING_BUF_SIZE];
+    bufRing = io_uring_setup_buf_ring(&ring, URING_BUF_COUNT, URING_BGID, 0, &ret);
+    if (!bufRing) {
+        std::cerr << "io_uring_setup_buf_ring: " << strerror(-ret) << std::endl;
+        abort();
+    }
+    for (int i = 0; i < URING_BUF_COUNT; ++i) {
+        io_uring_buf_ring_add(bufRing, bufBase + i * URING_BUF_SIZE, URING_BUF_SIZE, i,
+            io_uring_buf_ring_mask(URING_BUF_COUNT), i);
+    }
+    io_uring_buf_ring_advance(bufRing, URING_BUF_COUNT);
+
+    // 主从模式下的从 Reactor 没有监听套接字，传入 -1
+    if (sockfd != -1) {
+        newSlot(sockfd, Kind::Accept);
+        armAccept(sockfd);
+    }
+    newSlot(wakeupfd, Kind::Poll);
+    armPollIn(wakeupfd);
+}
+
+UringReactor::~UringReactor()
+{
+    io_uring_free_buf_ring(&ring, bufRing, URING_BUF_COUNT, URING_BGID);
+    io_uring_queue_exit(&ring);
+    delete[] bufBase;
+}
+
+void UringReactor::loop()
+{
+    run(-1);
+}
+
+void UringReactor::mqttLoop()
+{
+    run(10);
+}
+
+void UringReactor::run(int timeoutMs)
+{
+    stats.start();
+    while (1) {
+        for (int fd : acceptRetry) armAccept(fd);
+        acceptRetry.clear();
+
+        // 上一轮处理事件时攒下的 SQE（发送、重新挂载等）在这里一次性提交
+        struct io_uring_cqe* cqe;
+        stats.beforeWait();
+        if (busyPollUs > 0 && spin()) {
+            // 空转期间已经收到完成事件
+        }
+        else if (timeoutMs >= 0 || hasReady()) {
+            // 就绪链表里还有没收完的 fd（UDP 用完了读预算）时不能阻塞
+            struct __kernel_timespec ts = { 0, hasReady() ? 0 : (long long)timeoutMs * 1000000 };
+            io_uring_submit_and_wait_timeout(&ring, &cqe, 1, &ts, nullptr);
+        }
+        else {
+            io_uring_submit_and_wait(&ring, 1);
+        }
+
+        stats.afterWait((int)io_uring_cq_ready(&ring));
+
+        unsigned head, count = 0;
+        io_uring_for_each_cqe(&ring, head, cqe) {
+            ++count;
+            stats.callback(handleCqe(io_uring_cqe_get_data64(cqe), cqe->res, cqe->flags));
+        }
+        io_uring_cq_advance(&ring, count);
+        doReadyList();
+
+        if (timeoutMs >= 0) {
+            expireTimer(getWheel());
+            stats.timer();
+        }
+    }
+}
+
+bool UringReactor::spin()
+{
+    // 超时为 0 的 GETEVENTS：顺带提交攒下的 SQE，并让内核跑完 COOP_TASKRUN 推迟的完成任务
+    struct __kernel_timespec zero = { 0, 0 };
+    struct io_uring_cqe* cqe;
+    uint64_t deadline = LoopStats::now() + (uint64_t)busyPollUs * 1000;
+    do {
+        io_uring_submit_and_wait_timeout(&ring, &cqe, 1, &zero, nullptr);
+        if (io_uring_cq_ready(&ring)) {
+            stats.spun(true);
+            return true;
+        }
+    } while (LoopStats::now() < deadline);
+    stats.spun(false);
+    return false;
+}
+
+HandlerKind UringReactor::handleCqe(uint64_t data, int res, uint32_t flags)
+{
+    Op op = (Op)(data >> 56);
+    uint32_t gen = (data >> 32) & 0xffffff;
+    int fd = (int)(uint32_t)data;
+
+    if (op == OpCancel) return HandlerKind::Other;
+
+    // 1. fd 已注销或已被新连接复用：归还缓冲区、释放孤儿发送，丢弃事件
+    auto it = slots.find(fd);
+    if (it == slots.end() || it->second.gen != gen) {
+        recycle(flags);
+        if (op == OpSend) orphanSends.erase(data);
+        return HandlerKind::Other;
+    }
+    Slot& s = it->second;
+    bool more = flags & IORING_CQE_F_MORE;
+
+    // 回调里可能 remove 自己，先持有一份引用
+    std::shared_ptr<EventHandler> h = handler[fd];
+    HandlerKind kind = h ? h->kind() : HandlerKind::Other;
+    auto alive = [this, fd, gen]() {
+        auto i = slots.find(fd);
+        return i != slots.end() && i->second.gen == gen;
+    };
+
+    switch (op)
+    {
+    case OpAccept:
+        if (res >= 0) {
+            static_cast<AcceptHandler*>(h.get())->accepted(res);
+        }
+        else if (res == -EMFILE || res == -ENFILE) {
+            // 内核先分配 fd 再看队列，backlog 为空也会报 EMFILE；
+            // 直接重挂 accept 会原地空转，改挂一次 POLLIN，有新连接进来再丢弃
+            static_cast<AcceptHandler*>(h.get())->shed(fd);
+            armPollOnce(fd);
+            break;
+        }
+        else if (res != -EAGAIN) {
+            std::cerr << "accept error: " << strerror(-res) << std::endl;
+        }
+        if (!more) {
+            // 其他错误也会终止 multishot，推迟到下一轮再挂
+            if (res < 0) acceptRetry.push_back(fd);
+            else armAccept(fd);
+        }
+        break;
+
+    case OpRecv:
+    {
+        if (!more) s.receiving = false;
+        // 反压或连接限速推迟期间不再续挂，恢复时由 resumeRead 挂上；
+        // 否则 pauseRead 刚取消的 recv 马上又挂回去，限速的连接照样往缓冲区里灌数据
+        auto conn = static_cast<ConnectionHandler*>(h.get());
+        auto rearm = [&]() { return !ingressPaused && !conn->isThrottled(); };
+        if (res > 0) {
+            char* buf = bufBase + (flags >> IORING_CQE_BUFFER_SHIFT) * URING_BUF_SIZE;
+            conn->handleData(fd, buf, res);
+            recycle(flags);
+            if (!more && alive() && rearm()) armRecv(fd);
+        }
+        else if (res == -ENOBUFS) {
+            // 缓冲区环暂时被借空，缓冲区在本轮就会归还，直接重新挂上
+            if (!more && rearm()) armRecv(fd);
+        }
+        else if (res == -EINVAL && multishotRecv) {
+            multishotRecv = false;
+            if (rearm()) armRecv(fd);
+        }
+        else if (res == -ECANCELED) {
+            // pauseRead 取消的，连接本身没事；取消生效之前已经恢复的话在这里补挂
+            if (!more && rearm()) armRecv(fd);
+        }
+        else if (res == 0) {
+            static_cast<ConnectionHandler*>(h.get())->handleClose(fd);
+        }
+        else {
+            remove(fd);
+            close(fd);
+        }
+        break;
+    }
+
+    case OpSend:
+        if (res < 0) {
+            remove(fd);
+            close(fd);
+            break;
+        }
+        s.send->inflight.consume(res);
+        static_cast<ConnectionHandler*>(h.get())->sent(res);
+        if (s.send->inflight.empty()) {
+            // 发送期间又追加到 sendBuffer 的数据接着发，复用同一份发送状态
+            s.send->inflight.swap(static_cast<ConnectionHandler*>(h.get())->getSendBuffer());
+        }
+        if (!s.send->inflight.empty()) {
+            prepSend(fd, s);
+            break;
+        }
+        s.send.reset();
+        static_cast<ConnectionHandler*>(h.get())->notifyDrained(fd);
+        break;
+
+    case OpPollIn:
+        if (res < 0) {
+            if (res != -ECANCELED) std::cerr << "poll error: " << strerror(-res) << std::endl;
+            break;
+        }
+        if (s.kind == Kind::Accept) {
+            armAccept(fd);//EMFILE 之后等到了新连接，重新挂 accept
+            break;
+        }
+        if (res & (POLLIN | POLLPRI | POLLRDHUP)) {
+            h->handleRead(fd);
+        }
+        if (alive() && (res & (POLLERR | POLLHUP))) {
+            if (kind == HandlerKind::Mqtt) {
+                static_cast<MqttHandler*>(h.get())->reconnect(fd);//同 epoll 后端：交给 MqttHandler 重连
+                break;
+            }
+            remove(fd);
+            close(fd);
+            break;
+        }
+        if (!more && alive()) armPollIn(fd);
+        break;
+
+    case OpPollOut:
+        s.pollOut = false;
+        if (res > 0) {
+            h->handleWrite(fd);
+        }
+        break;
+
+    default:
+        break;
+    }
+    return kind;
+}
+
+void UringReactor::register_(int cfd, uint32_t mode)
+{
+    newSlot(cfd, Kind::Connection);
+    if (!ingressPaused) armRecv(cfd);
+    attachConnection(cfd);//协程会话在这里启动，先把接收挂好
+}
+
+void UringReactor::mqttRegister(int fd, uint32_t mode, const std::shared_ptr<MqttHandler>& ptr, struct mosquitto* mosq)
+{
+    newSlot(fd, Kind::Poll);
+    attachMqtt(fd, ptr, mosq);
+    armPollIn(fd);
+    if (mode & EPOLLOUT) {
+        update(fd, mode);
+    }
+}
+
+void UringReactor::udpRegister(int fd)
+{
+    // 数据报由处理器自己用 recvmmsg 成批收，这里和 MQTT 一样只挂 poll
+    newSlot(fd, Kind::Poll);
+    attachUdp(fd);
+    armPollIn(fd);
+}
+
+void UringReactor::localRegister(int fd, bool ring)
+{
+    newSlot(fd, Kind::Accept);
+    attachLocal(fd, ring);
+    armAccept(fd);
+}
+
+void UringReactor::ringRegister(int fd, const std::shared_ptr<RingHandler>& h)
+{
+    // 环在共享内存里直接读，eventfd 和控制连接都只需要可读通知
+    newSlot(fd, Kind::Poll);
+    attachRing(fd, h);
+    armPollIn(fd);
+}
+
+void UringReactor::remove(int cfd)
+{
+    auto it = slots.find(cfd);
+    if (it != slots.end()) {
+        Slot& s = it->second;
+        if (s.send) {
+            orphanSends.emplace(makeData(OpSend, s.gen, cfd), std::move(s.send));
+        }
+        // 调用者紧接着就会 close，必须在 fd 号被复用之前把取消请求交给内核
+        struct io_uring_sqe* sqe = getSqe();
+        io_uring_prep_cancel_fd(sqe, cfd, IORING_ASYNC_CANCEL_ALL);
+        io_uring_sqe_set_data64(sqe, makeData(OpCancel, 0, cfd));
+        io_uring_submit(&ring);
+        slots.erase(it);
+    }
+    detach(cfd);
+}
+
+void UringReactor::update(int cfd, uint32_t mode)
+{
+    auto it = slots.find(cfd);
+    if (it == slots.end() || !(mode & EPOLLOUT)) return;
+
+    // 读方向一直挂着，只需要处理写
+    Slot& s = it->second;
+    if (s.kind == Kind::Connection) {
+        startSend(cfd);
+    }
+    else if (s.kind == Kind::Poll && !s.pollOut) {
+        s.pollOut = true;
+        armPollOut(cfd);
+    }
+}
+
+void UringReactor::pauseRead(int cfd)
+{
+    auto it = slots.find(cfd);
+    if (it == slots.end() || !it->second.receiving) return;
+
+    // multishot recv 会一直往下收，只能取消；已经在路上的完成事件照常处理
+    struct io_uring_sqe* sqe = getSqe();
+    io_uring_prep_cancel64(sqe, makeData(OpRecv, it->second.gen, cfd), 0);
+    io_uring_sqe_set_data64(sqe, makeData(OpCancel, 0, cfd));
+}
+
+void UringReactor::resumeRead(int cfd)
+{
+    auto it = slots.find(cfd);
+    if (it == slots.end() || it->second.receiving) return;//取消还没生效的，recv 仍然挂着
+    armRecv(cfd);
+}
+
+UringReactor::Slot& UringReactor::newSlot(int fd, Kind kind)
+{
+    Slot& s = slots[fd];
+    s = Slot();
+    s.gen = ++nextGen & 0xffffff;
+    s.kind = kind;
+    return s;
+}
+
+struct io_uring_sqe* UringReactor::getSqe()
+{
+    struct io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+    if (!sqe) {
+        // SQ 满了，先把攒下的提交掉
+        io_uring_submit(&ring);
+        sqe = io_uring_get_sqe(&ring);
+    }
+    return sqe;
+}
+
+void UringReactor::armAccept(int fd)
+{
+    struct io_uring_sqe* sqe = getSqe();
+    io_uring_prep_multishot_accept(sqe, fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    io_uring_sqe_set_data64(sqe, makeData(OpAccept, slots[fd].gen, fd));
+}
+
+void UringReactor::armRecv(int fd)
+{
+    struct io_uring_sqe* sqe = getSqe();
+    if (multishotRecv) {
+        io_uring_prep_recv_multishot(sqe, fd, nullptr, 0, 0);
+    }
+    else {
+        io_uring_prep_recv(sqe, fd, nullptr, URING_BUF_SIZE, 0);
+    }
+    sqe->flags |= IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BGID;
+    Slot& s = slots[fd];
+    s.receiving = true;
+    io_uring_sqe_set_data64(sqe, makeData(OpRecv, s.gen, fd));
+}
+
+void UringReactor::armPollIn(int fd)
+{
+    struct io_uring_sqe* sqe = getSqe();
+    io_uring_prep_poll_multishot(sqe, fd, POLLIN | POLLPRI | POLLRDHUP);
+    io_uring_sqe_set_data64(sqe, makeData(OpPollIn, slots[fd].gen, fd));
+}
+
+void UringReactor::armPollOnce(int fd)
+{
+    struct io_uring_sqe* sqe = getSqe();
+    io_uring_prep_poll_add(sqe, fd, POLLIN);
+    io_uring_sqe_set_data64(sqe, makeData(OpPollIn, slots[fd].gen, fd));
+}
+
+void UringReactor::armPollOut(int fd)
+{
+    struct io_uring_sqe* sqe = getSqe();
+    io_uring_prep_poll_add(sqe, fd, POLLOUT);
+    io_uring_sqe_set_data64(sqe, makeData(OpPollOut, slots[fd].gen, fd));
+}
+
+void UringReactor::startSend(int fd)
+{
+    Slot& s = slots[fd];
+    if (s.send) return;//完成后会再来取
+
+    auto conn = static_cast<ConnectionHandler*>(handler[fd].get());
+    OutputChain& buf = conn->getSendBuffer();
+    if (buf.empty()) return;
+
+    // 把待发的块链整体换出来交给内核，只交换头尾指针；发送期间 sendBuffer 可以继续追加
+    s.send.reset(new SendState);
+    s.send->inflight.swap(buf);
+    prepSend(fd, s);
+}
+
+void UringReactor::prepSend(int fd, Slot& s)
+{
+    struct io_uring_sqe* sqe = getSqe();
+    SendState& st = *s.send;
+    st.msg = {};
+    st.msg.msg_iov = st.iov;
+    st.msg.msg_iovlen = st.inflight.peek(st.iov, OUTPUT_IOV_MAX);
+    io_uring_prep_sendmsg(sqe, fd, &st.msg, MSG_NOSIGNAL);
+    io_uring_sqe_set_data64(sqe, makeData(OpSend, s.gen, fd));
+}
+
+void UringReactor::recycle(uint32_t flags)
+{
+    if (!(flags & IORING_CQE_F_BUFFER)) return;
+    int bid = flags >> IORING_CQE_BUFFER_SHIFT;
+    io_uring_buf_ring_add(bufRing, bufBase + bid * URING_BUF_SIZE, URING_BUF_SIZE, bid,
+        io_uring_buf_ring_mask(URING_BUF_COUNT), 0);
+    io_uring_buf_ring_advance(bufRing, 1);
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+#include <sys/socket.h>
+#include <liburing.h>
+#include "IReactor.h"
+#include "outputchain.h"
+
+#define URING_ENTRIES 4096
+#define URING_BUF_COUNT 1024 // 提供给内核的接收缓冲区个数，必须是 2 的幂
+#define URING_BUF_SIZE 2048 // 一次接收的上限；SOCK_SEQPACKET 的一条记录超过它会被内核截断
+#define URING_BGID 0
+
+
+// io_uring 后端
+// 监听套接字用 multishot accept，连接用 multishot recv + 内核选取的缓冲区环，
+// 发送在每轮循环末尾和其他请求一起批量提交；MQTT、eventfd 等自己做读写的 fd 退化为 poll
+class UringReactor : public IReactor
+{
+private:
+    enum Op : uint8_t { OpAccept = 1, OpRecv, OpSend, OpPollIn, OpPollOut, OpCancel };
+    enum class Kind : char { Accept, Connection, Poll };
+
+    // 正在发送的数据：发送期间才分配，空闲连接不占这份内存
+    struct SendState
+    {
+        OutputChain inflight;//内核正在发送，部分发送只推进头块偏移
+        struct msghdr msg;//sendmsg 的描述在提交时被内核拷走，这里只需活到提交
+        struct iovec iov[OUTPUT_IOV_MAX];
+    };
+
+    // 每个 fd 的提交状态；gen 用来识别 fd 号复用后迟到的旧完成事件
+    struct Slot
+    {
+        uint32_t gen;
+        Kind kind;
+        bool pollOut = false;//已挂上一次性的 POLLOUT
+        bool receiving = false;//已挂上 recv，还没收到终止它的完成事件
+        std::unique_ptr<SendState> send;//非空表示有发送在路上
+    };
+
+    struct io_uring ring;
+    struct io_uring_buf_ring* bufRing;
+    char* bufBase;
+
+    std::unordered_map<int, Slot> slots;
+    std::unordered_map<uint64_t, std::unique_ptr<SendState>> orphanSends;//连接已注销但内核还没完成的发送，等完成事件再释放
+    uint32_t nextGen = 0;
+    bool multishotRecv = true;//5.19 内核只有缓冲区环没有 multishot recv，遇到 EINVAL 后降级
+    std::vector<int> acceptRetry;//accept 因 EMFILE 等错误停止的监听套接字，下一轮循环重新挂上
+
+public:
+    explicit UringReactor(int s, struct mosquitto* m);
+    ~UringReactor();
+
+    void loop() override;
+    void mqttLoop() override;
+    void register_(int cfd, uint32_t mode) override;
+    void mqttRegister(int fd, uint32_t mode, const std::shared_ptr<MqttHandler>& ptr, struct mosquitto* mosq) override;
+    void remove(int cfd) override;
+    void update(int cfd, uint32_t mode) override;
+    void udpRegister(int fd) override;
+    void localRegister(int fd, bool ring) override;
+    void ringRegister(int fd, const std::shared_ptr<RingHandler>& h) override;
+
+protected:
+    void pauseRead(int cfd) override;
+    void resumeRead(int cfd) override;
+
+public:
+
+    static bool supported();//内核是否支持本后端用到的特性（缓冲区环，5.19+）
+
+private:
+    void run(int timeoutMs);
+    bool spin();//busyPollUs > 0 时不阻塞地反复收割完成事件，等到了返回 true
+    HandlerKind handleCqe(uint64_t data, int res, uint32_t flags);//返回处理器类型供统计使用
+
+    Slot& newSlot(int fd, Kind kind);
+    struct io_uring_sqe* getSqe();
+    void armAccept(int fd);
+    void armRecv(int fd);
+    void armPollIn(int fd);
+    void armPollOnce(int fd);
+    void armPollOut(int fd);
+    void startSend(int fd);
+    void prepSend(int fd, Slot& s);
+    void recycle(uint32_t flags);
+
+    static uint64_t makeData(Op op, uint32_t gen, int fd)
+    {
+        return ((uint64_t)op << 56) | ((uint64_t)(gen & 0xffffff) << 32) | (uint32_t)fd;
+    }
+};
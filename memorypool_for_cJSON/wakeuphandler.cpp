@@ -0,0 +1,16 @@
+#include "wakeuphandler.h"
+#include "reactor.h"
+
+#include <sys/eventfd.h>
+#include <cerrno>
+#include <cstdio>
+
+void WakeupHandler::handleRead(int fd)
+{
+    // 必须先清零计数再取队列：取队列期间新写入的 eventfd 会产生新的边沿，不会丢唤醒
+    eventfd_t value;
+    if (eventfd_read(fd, &value) < 0 && errno != EAGAIN) {
+        perror("eventfd_read");
+    }
+    reactor->doPendingWork();
+}
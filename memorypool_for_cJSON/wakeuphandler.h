@@ -0,0 +1,12 @@
+#pragma once
+#include "eventhandler.h"
+
+// eventfd 唤醒处理器：其他线程往 Reactor 投递数据后写 eventfd，Reactor 线程在这里取走
+class WakeupHandler : public EventHandler
+{
+public:
+    void handleRead(int fd) override;
+    void handleWrite(int fd) override {}
+    HandlerKind kind() const override { return HandlerKind::Wakeup; }
+    explicit WakeupHandler(IReactor* r, Protocol* p) : EventHandler(r, p) {}
+};